@@ -0,0 +1,56 @@
+// Batched agent step kernel body:
+// =========
+// Included by agents.h once per instruction set, with the AGENT_* macros describing the lanes.
+// Mirrors advanceAgentsScalar() operation for operation, so every lane advances its agent exactly as the
+// scalar kernel would.
+
+AGENT_TARGET void AGENT_FUNCTION(int first, int last, float deltaTime) {
+    const AGENT_FLOAT zero = AGENT_SET1(0);
+    const AGENT_FLOAT one = AGENT_SET1(1);
+    const AGENT_FLOAT two = AGENT_SET1(2);
+    const AGENT_FLOAT elapsed = AGENT_SET1(deltaTime);
+    const AGENT_FLOAT inverseTile = AGENT_SET1(1.0f / TILE_SIZE);
+    const AGENT_FLOAT mapWidth = AGENT_SET1(map.width);
+    const AGENT_FLOAT mapHeight = AGENT_SET1(map.height);
+    int i = first;
+    for (; i + AGENT_WIDTH <= last; i += AGENT_WIDTH) {
+        // The rotation matrix of each lane's turn this tick, from its rotation amount (as setRotationVector()):
+        const AGENT_FLOAT t = AGENT_MUL(AGENT_LOAD(&agents.turnSpeeds[i]), elapsed);
+        const AGENT_FLOAT t2 = AGENT_MUL(t, t);
+        const AGENT_FLOAT factor = AGENT_DIV(one, AGENT_ADD(one, t2));
+        const AGENT_FLOAT cosine = AGENT_MUL(AGENT_SUB(one, t2), factor);
+        const AGENT_FLOAT sine = AGENT_MUL(AGENT_MUL(two, t), factor);
+
+        const AGENT_FLOAT orientationX = AGENT_LOAD(&agents.orientationX[i]);
+        const AGENT_FLOAT orientationY = AGENT_LOAD(&agents.orientationY[i]);
+        const AGENT_FLOAT turnedX = AGENT_SUB(AGENT_MUL(cosine, orientationX), AGENT_MUL(sine, orientationY));
+        const AGENT_FLOAT turnedY = AGENT_ADD(AGENT_MUL(sine, orientationX), AGENT_MUL(cosine, orientationY));
+        AGENT_STORE(&agents.orientationX[i], turnedX);
+        AGENT_STORE(&agents.orientationY[i], turnedY);
+
+        const AGENT_FLOAT step = AGENT_MUL(AGENT_LOAD(&agents.walkSpeeds[i]), elapsed);
+        const AGENT_FLOAT x = AGENT_LOAD(&agents.x[i]);
+        const AGENT_FLOAT y = AGENT_LOAD(&agents.y[i]);
+        const AGENT_FLOAT newX = AGENT_ADD(x, AGENT_MUL(turnedX, step));
+        const AGENT_FLOAT newY = AGENT_ADD(y, AGENT_MUL(turnedY, step));
+
+        // Agents are always inside the map, but where they'd end up might not be. Coordinates inside the map
+        // are never negative, so truncation is the same as floor():
+        const int move = i - first;
+        const int outsideX = AGENT_MOVEMASK(AGENT_OR(AGENT_CMPLT(newX, zero), AGENT_CMPGE(newX, mapWidth)));
+        const int outsideY = AGENT_MOVEMASK(AGENT_OR(AGENT_CMPLT(newY, zero), AGENT_CMPGE(newY, mapHeight)));
+        AGENT_STORE(&agentMoves.x[move], newX);
+        AGENT_STORE(&agentMoves.y[move], newY);
+        AGENT_STORE_INT(&agentMoves.columns[move], AGENT_MUL(x, inverseTile));
+        AGENT_STORE_INT(&agentMoves.rows[move], AGENT_MUL(y, inverseTile));
+        AGENT_STORE_INT(&agentMoves.newColumns[move], AGENT_MUL(newX, inverseTile));
+        AGENT_STORE_INT(&agentMoves.newRows[move], AGENT_MUL(newY, inverseTile));
+        for (int lane = 0; (outsideX | outsideY) >> lane; lane++) {
+            if ((outsideX >> lane) & 1)
+                agentMoves.newColumns[move + lane] = -1;
+            if ((outsideY >> lane) & 1)
+                agentMoves.newRows[move + lane] = -1;
+        }
+    }
+    advanceAgentsScalar(i, last, deltaTime, i - first);
+}
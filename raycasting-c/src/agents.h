@@ -0,0 +1,294 @@
+// Batched agents:
+// =========
+// Agents walk the map like the player does (turning by a rotation amount and walking along their orientation
+// every tick), but in batches of tens of thousands, so they're kept as arrays of each of their fields rather
+// than as an array of agents. Agents are stepped in batches of AGENT_BATCH_SIZE, in two passes: the first
+// turns them, and finds where they'd end up and the cells they'd cross, a SIMD lane per agent with one load per
+// field (see agent_kernel.h), with SSE2 or AVX2 picked at startup as the packet kernels are (and the scalar
+// kernel for the rest, or with --packet-width 1). The second resolves their collisions one by one, since each
+// is a lookup of the map (and keeps the scalar code out of the vector kernels, where it'd stall on the upper
+// halves of AVX registers).
+// Cells are found by truncating positions scaled by 1 / TILE_SIZE, and an agent walking into a wall slides
+// along it: it keeps whichever half of its step (along x or along y) doesn't enter a wall, and only turns back
+// when neither does, in a corner. Thin walls block agents unless they're fully open, as they block the player.
+// The agents are stepped in tiles of AGENT_TILE_SIZE on the workers, each agent only ever writing its own
+// fields, so the result doesn't depend on the number of workers.
+#define AGENT_TILE_SIZE 4096
+#define AGENT_BATCH_SIZE 256 // so a batch's moves stay in the L1 cache
+#define AGENT_MIN_WALK_SPEED 50.0f // map units per second
+#define AGENT_MAX_WALK_SPEED 150.0f
+#define AGENT_MAX_TURN_SPEED 0.5f  // rotation amount per second
+
+typedef void (*AgentKernel)(int first, int last, float deltaTime);
+
+// Where the agents of a batch would end up, by their index in the batch (with cells of -1 outside the map):
+struct AgentMoves {
+    float x[AGENT_BATCH_SIZE];
+    float y[AGENT_BATCH_SIZE];
+    int columns[AGENT_BATCH_SIZE]; // of the cells they're in
+    int rows[AGENT_BATCH_SIZE];
+    int newColumns[AGENT_BATCH_SIZE];
+    int newRows[AGENT_BATCH_SIZE];
+};
+__thread struct AgentMoves agentMoves;
+
+struct Agents {
+    // One array per field, of capacity entries each:
+    float* x;
+    float* y;
+    float* orientationX;
+    float* orientationY;
+    float* turnSpeeds;
+    float* walkSpeeds;
+    int count;
+    int capacity;
+
+    AgentKernel kernel;
+    const char* kernelName;
+    float deltaTime; // of the tick being stepped
+
+    // Counters:
+    long long steps;
+    long long stepTime;
+} agents = {.kernelName = "scalar"};
+
+int agentCanEnter(float x, float y, int column, int row) {
+    // Whether an agent can stand at a point of a cell (-1 for a point outside the map):
+    if (column < 0 || row < 0)
+        return FALSE;
+    const int content = mapContentAt(column, row);
+    return content == 0 || (content == MAP_THIN_WALL && isThinWallOpenAt(x, y));
+}
+
+void moveAgents(int first, int last) {
+    // Moves the agents of a batch towards where they'd end up, sliding along the walls in the way:
+    for (int i = first; i < last; i++) {
+        const int move = i - first;
+        const float newX = agentMoves.x[move];
+        const float newY = agentMoves.y[move];
+        if (agentCanEnter(newX, newY, agentMoves.newColumns[move], agentMoves.newRows[move])) {
+            agents.x[i] = newX;
+            agents.y[i] = newY;
+        } else if (agentCanEnter(newX, agents.y[i], agentMoves.newColumns[move], agentMoves.rows[move]))
+            agents.x[i] = newX;
+        else if (agentCanEnter(agents.x[i], newY, agentMoves.columns[move], agentMoves.newRows[move]))
+            agents.y[i] = newY;
+        else {
+            agents.orientationX[i] = -agents.orientationX[i];
+            agents.orientationY[i] = -agents.orientationY[i];
+        }
+    }
+}
+
+int agentCellOf(float coordinate, float size) {
+    return coordinate < 0 || coordinate >= size ? -1 : (int)(coordinate * (1.0f / TILE_SIZE));
+}
+
+void advanceAgentsScalar(int first, int last, float deltaTime, int firstMove) {
+    // Turns the agents of a batch, and finds where they'd end up (from the batch's firstMove):
+    for (int i = first; i < last; i++) {
+        const float t = agents.turnSpeeds[i] * deltaTime;
+        const float t2 = t * t;
+        const float factor = 1 / (1 + t2);
+        const float cosine = (1 - t2) * factor;
+        const float sine = (2 * t) * factor;
+        const float orientationX = agents.orientationX[i];
+        const float orientationY = agents.orientationY[i];
+        agents.orientationX[i] = cosine * orientationX - sine * orientationY;
+        agents.orientationY[i] = sine * orientationX + cosine * orientationY;
+
+        const float step = agents.walkSpeeds[i] * deltaTime;
+        const float newX = agents.x[i] + agents.orientationX[i] * step;
+        const float newY = agents.y[i] + agents.orientationY[i] * step;
+        const int move = firstMove + i - first;
+        agentMoves.x[move] = newX;
+        agentMoves.y[move] = newY;
+        agentMoves.columns[move] = (int)(agents.x[i] * (1.0f / TILE_SIZE));
+        agentMoves.rows[move] = (int)(agents.y[i] * (1.0f / TILE_SIZE));
+        agentMoves.newColumns[move] = agentCellOf(newX, map.width);
+        agentMoves.newRows[move] = agentCellOf(newY, map.height);
+    }
+}
+
+void advanceAgentsScalarBatch(int first, int last, float deltaTime) {
+    advanceAgentsScalar(first, last, deltaTime, 0);
+}
+
+#ifdef PACKET_SIMD
+#define AGENT_WIDTH 4
+#define AGENT_TARGET __attribute__((target("sse2")))
+#define AGENT_FUNCTION advanceAgentsSSE2
+#define AGENT_FLOAT __m128
+#define AGENT_LOAD(p) _mm_loadu_ps(p)
+#define AGENT_STORE(p, v) _mm_storeu_ps(p, v)
+#define AGENT_STORE_INT(p, v) _mm_storeu_si128((__m128i*)(p), _mm_cvttps_epi32(v))
+#define AGENT_SET1(f) _mm_set1_ps(f)
+#define AGENT_ADD(a, b) _mm_add_ps(a, b)
+#define AGENT_SUB(a, b) _mm_sub_ps(a, b)
+#define AGENT_MUL(a, b) _mm_mul_ps(a, b)
+#define AGENT_DIV(a, b) _mm_div_ps(a, b)
+#define AGENT_OR(a, b) _mm_or_ps(a, b)
+#define AGENT_CMPLT(a, b) _mm_cmplt_ps(a, b)
+#define AGENT_CMPGE(a, b) _mm_cmpge_ps(a, b)
+#define AGENT_MOVEMASK(v) _mm_movemask_ps(v)
+#include "agent_kernel.h"
+#undef AGENT_WIDTH
+#undef AGENT_TARGET
+#undef AGENT_FUNCTION
+#undef AGENT_FLOAT
+#undef AGENT_LOAD
+#undef AGENT_STORE
+#undef AGENT_STORE_INT
+#undef AGENT_SET1
+#undef AGENT_ADD
+#undef AGENT_SUB
+#undef AGENT_MUL
+#undef AGENT_DIV
+#undef AGENT_OR
+#undef AGENT_CMPLT
+#undef AGENT_CMPGE
+#undef AGENT_MOVEMASK
+
+#define AGENT_WIDTH 8
+#define AGENT_TARGET __attribute__((target("avx2")))
+#define AGENT_FUNCTION advanceAgentsAVX2
+#define AGENT_FLOAT __m256
+#define AGENT_LOAD(p) _mm256_loadu_ps(p)
+#define AGENT_STORE(p, v) _mm256_storeu_ps(p, v)
+#define AGENT_STORE_INT(p, v) _mm256_storeu_si256((__m256i*)(p), _mm256_cvttps_epi32(v))
+#define AGENT_SET1(f) _mm256_set1_ps(f)
+#define AGENT_ADD(a, b) _mm256_add_ps(a, b)
+#define AGENT_SUB(a, b) _mm256_sub_ps(a, b)
+#define AGENT_MUL(a, b) _mm256_mul_ps(a, b)
+#define AGENT_DIV(a, b) _mm256_div_ps(a, b)
+#define AGENT_OR(a, b) _mm256_or_ps(a, b)
+#define AGENT_CMPLT(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define AGENT_CMPGE(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define AGENT_MOVEMASK(v) _mm256_movemask_ps(v)
+#include "agent_kernel.h"
+#undef AGENT_WIDTH
+#undef AGENT_TARGET
+#undef AGENT_FUNCTION
+#undef AGENT_FLOAT
+#undef AGENT_LOAD
+#undef AGENT_STORE
+#undef AGENT_STORE_INT
+#undef AGENT_SET1
+#undef AGENT_ADD
+#undef AGENT_SUB
+#undef AGENT_MUL
+#undef AGENT_DIV
+#undef AGENT_OR
+#undef AGENT_CMPLT
+#undef AGENT_CMPGE
+#undef AGENT_MOVEMASK
+#endif
+
+void selectAgentKernel(int maxWidth) {
+    // Picks the widest kernel the CPU supports, up to maxWidth lanes (1 for the scalar kernel):
+    agents.kernel = advanceAgentsScalarBatch;
+    agents.kernelName = "scalar";
+#ifdef PACKET_SIMD
+    __builtin_cpu_init();
+    if (maxWidth >= 8 && __builtin_cpu_supports("avx2")) {
+        agents.kernel = advanceAgentsAVX2;
+        agents.kernelName = "avx2";
+    } else if (maxWidth >= 4 && __builtin_cpu_supports("sse2")) {
+        agents.kernel = advanceAgentsSSE2;
+        agents.kernelName = "sse2";
+    }
+#endif
+}
+
+int addAgent(float x, float y, float orientationAmount, float turnSpeed, float walkSpeed) {
+    // Facing the direction of a rotation amount from +x (as setRotationVector()):
+    if (agents.count == agents.capacity) {
+        const int capacity = agents.capacity ? agents.capacity * 2 : AGENT_TILE_SIZE;
+        float** fields[] = {&agents.x, &agents.y, &agents.orientationX, &agents.orientationY, &agents.turnSpeeds, &agents.walkSpeeds};
+        for (int field = 0; field < (int)(sizeof(fields) / sizeof(fields[0])); field++) {
+            float* values = (float*) realloc(*fields[field], sizeof(float) * capacity);
+            if (!values) {
+                fprintf(stderr, "Error allocating agents.\n");
+                return FALSE;
+            }
+            *fields[field] = values;
+        }
+        agents.capacity = capacity;
+    }
+
+    vec2 orientation;
+    setRotationVector(&orientation, orientationAmount);
+    const int i = agents.count++;
+    agents.x[i] = x;
+    agents.y[i] = y;
+    agents.orientationX[i] = orientation.x;
+    agents.orientationY[i] = orientation.y;
+    agents.turnSpeeds[i] = turnSpeed;
+    agents.walkSpeeds[i] = walkSpeed;
+    return TRUE;
+}
+
+int scatterAgents(int count, unsigned int seed) {
+    // Puts agents at random spots of empty cells, facing every way (every other one flipped, since rotation
+    // amounts from -1 to 1 only cover half a turn), and walking and turning at random speeds:
+    unsigned int random = seed ? seed : 1;
+    const int maxAttempts = count * 100;
+    for (int attempts = 0; count > 0 && attempts < maxAttempts; attempts++) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        const float x = (float)(random % (unsigned int)map.width);
+        const float y = (float)((random / (unsigned int)map.width) % (unsigned int)map.height);
+        if (mapContentAt((int)(x / TILE_SIZE), (int)(y / TILE_SIZE)) != 0)
+            continue;
+        const float orientationAmount = (float)((random >> 8) & 255) / 128 - 1;
+        const float turnSpeed = AGENT_MAX_TURN_SPEED * ((float)((random >> 16) & 255) / 128 - 1);
+        const float walkSpeed = AGENT_MIN_WALK_SPEED + (AGENT_MAX_WALK_SPEED - AGENT_MIN_WALK_SPEED) * (float)(random >> 24) / 255;
+        if (!addAgent(x, y, orientationAmount, turnSpeed, walkSpeed))
+            return FALSE;
+        if (random & 1) {
+            agents.orientationX[agents.count - 1] = -agents.orientationX[agents.count - 1];
+            agents.orientationY[agents.count - 1] = -agents.orientationY[agents.count - 1];
+        }
+        count--;
+    }
+    return TRUE;
+}
+
+void freeAgents() {
+    free(agents.x);
+    free(agents.y);
+    free(agents.orientationX);
+    free(agents.orientationY);
+    free(agents.turnSpeeds);
+    free(agents.walkSpeeds);
+    agents.x = agents.y = agents.orientationX = agents.orientationY = agents.turnSpeeds = agents.walkSpeeds = NULL;
+    agents.count = agents.capacity = 0;
+}
+
+void stepAgentTile(int tile) {
+    const int first = tile * AGENT_TILE_SIZE;
+    const int last = first + AGENT_TILE_SIZE < agents.count ? first + AGENT_TILE_SIZE : agents.count;
+    for (int batch = first; batch < last; batch += AGENT_BATCH_SIZE) {
+        const int batchEnd = batch + AGENT_BATCH_SIZE < last ? batch + AGENT_BATCH_SIZE : last;
+        agents.kernel(batch, batchEnd, agents.deltaTime);
+        moveAgents(batch, batchEnd);
+    }
+}
+
+void stepAgents(float deltaTime) {
+    // A tick of every agent:
+    if (agents.count == 0)
+        return;
+    const long long start = clockNanoseconds(CLOCK_MONOTONIC);
+    agents.deltaTime = deltaTime;
+    runWorkers(stepAgentTile, (agents.count + AGENT_TILE_SIZE - 1) / AGENT_TILE_SIZE);
+    agents.steps += agents.count;
+    agents.stepTime += clockNanoseconds(CLOCK_MONOTONIC) - start;
+}
+
+void printAgentReport() {
+    printf("agents: %d, %s kernel, %lld steps, %.0f agent-steps/sec\n", agents.count, agents.kernelName, agents.steps,
+        agents.stepTime > 0 ? agents.steps / (agents.stepTime / 1e9) : 0.0);
+}
+// =========
@@ -0,0 +1,607 @@
+// Headless benchmark harness:
+// =========
+// Drives setup(), tickSimulation(), castAllRays() and generate3DProjection() against the plain colorBuffer
+// without any SDL window, replaying a scripted camera path for a fixed number of frames.
+// Every stage is timed with a monotonic clock and summarized as min/median/p99 nanoseconds per frame.
+// Instead of the scripted path, a recording can be replayed (see replay.h), and the hash of every frame
+// written as golden hashes, or checked against them, to make sure an optimization didn't change any frame.
+// Frames can also be streamed to a viewer (see stream.h), e.g: --stream unix:/tmp/raycast.sock --paced 30.
+// With --agents N, N agents are stepped with every tick of the simulation (see agents.h), and their throughput
+// reported in agent-steps per second, with the hash of where they all ended up (with --hash).
+// With --low-walls PERCENT, that percentage of the walls inside the map's border are lowered (see heights.h).
+// With --open-map COLUMNS ROWS, the map is generated without walls around its border, for the rays that run
+// off the map's edge (e.g: make check).
+#include <string.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_FRAMES 600
+#define BENCH_MAX_DUMPED_FRAMES 16
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define BENCH_DELTA_TIME (1.0f / FPS)
+
+enum BenchStage {
+    STAGE_TICK_SIMULATION,
+    STAGE_CAST_ALL_RAYS,
+    STAGE_PROJECTION,
+    STAGE_CAST_AND_PROJECT,
+    STAGE_RENDER_VIEWS,
+    STAGE_FRAME,
+    STAGE_COUNT
+};
+const char* benchStageNames[STAGE_COUNT] = {
+    "tickSimulation",
+    "castAllRays",
+    "generate3DProjection",
+    "castAndProjectAllRays",
+    "renderViews",
+    "frame"
+};
+
+struct BenchStep {
+    int walkDirection;
+    int turnDirection;
+    int frames;
+};
+
+// The camera path is replayed in a loop, so it should visit open space, walls and turns in both directions:
+const struct BenchStep benchPath[] = {
+    { 0, +1, 90},
+    {+1,  0, 60},
+    { 0, -1, 45},
+    {-1,  0, 60},
+    {+1, +1, 120},
+    { 0,  0, 15},
+    {+1, -1, 90},
+    {-1, -1, 60}
+};
+// Paths for measuring the coherence cache: standing still, and turning on the spot:
+const struct BenchStep benchIdlePath[] = {
+    { 0,  0, 60}
+};
+const struct BenchStep benchTurningPath[] = {
+    { 0, +1, 90},
+    { 0, -1, 90}
+};
+#define BENCH_PATH_LENGTH(path) (int)(sizeof(path) / sizeof(path[0]))
+
+struct BenchOptions {
+    int frames;
+    int hashFrames;
+    int fused;
+    int paced;
+    int views;
+    int depthOnly;
+    int sprites;
+    int doors;
+    int agents;
+    int lowWalls;
+    const char* pathName;
+    const struct BenchStep* path;
+    int pathLength;
+    const char* streamAddress;
+    const char* recordingPath;
+    const char* replayPath;
+    const char* goldenPath;
+    int isCheckingGolden;
+    int dumpedFrames;
+    int dumpFrames[BENCH_MAX_DUMPED_FRAMES];
+    const char* dumpPaths[BENCH_MAX_DUMPED_FRAMES];
+} benchOptions;
+
+long long *benchSamples[STAGE_COUNT];
+int benchStageMeasured[STAGE_COUNT];
+unsigned long long benchHash = FNV_OFFSET_BASIS;
+unsigned long long* frameHashes = NULL; // each frame's own, for golden hashes
+
+long long benchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void hashBytes(unsigned long long* hash, const void* data, size_t size) {
+    // FNV-1a, continuing from the given hash (so it can be chained across frames):
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        *hash ^= bytes[i];
+        *hash *= 1099511628211ULL;
+    }
+}
+void hashPixels(unsigned long long* hash, const Uint32* pixels) {
+    hashBytes(hash, pixels, sizeof(Uint32) * (size_t)WINDOW_WIDTH * (size_t)WINDOW_HEIGHT);
+}
+void hashDepthColumns(unsigned long long* hash, const struct DepthColumns* columns) {
+    hashBytes(hash, columns->depths, sizeof(columns->depths));
+    hashBytes(hash, columns->wallContents, sizeof(columns->wallContents));
+    hashBytes(hash, columns->wasHitVertical, sizeof(columns->wasHitVertical));
+}
+
+int writePPM(const char* path, const Uint32* pixels) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error creating image file %s.\n", path);
+        return FALSE;
+    }
+    int saved = fprintf(file, "P6\n%d %d\n255\n", WINDOW_WIDTH, WINDOW_HEIGHT) > 0;
+    for (size_t i = 0; i < (size_t)WINDOW_WIDTH * WINDOW_HEIGHT && saved; i++) {
+        const unsigned char rgb[3] = {(pixels[i] >> 16) & 0xFF, (pixels[i] >> 8) & 0xFF, pixels[i] & 0xFF};
+        saved = fwrite(rgb, 3, 1, file) == 1;
+    }
+    if (fclose(file) != 0 || !saved) {
+        fprintf(stderr, "Error writing image file %s.\n", path);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+int writeGoldenHashes(const char* path, int frames) {
+    // One hash per line, in hexadecimal:
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error creating golden hashes file %s.\n", path);
+        return FALSE;
+    }
+    int saved = TRUE;
+    for (int frame = 0; frame < frames && saved; frame++)
+        saved = fprintf(file, "%016llx\n", frameHashes[frame]) > 0;
+    if (fclose(file) != 0 || !saved) {
+        fprintf(stderr, "Error writing golden hashes file %s.\n", path);
+        return FALSE;
+    }
+    printf("golden hashes: %d frames written to %s\n", frames, path);
+    return TRUE;
+}
+
+int checkGoldenHashes(const char* path, int frames) {
+    // Returns whether every frame matches its golden hash, reporting the first frame that doesn't:
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Error opening golden hashes file %s.\n", path);
+        return FALSE;
+    }
+    int goldenFrames = 0, mismatches = 0, firstMismatch = -1;
+    unsigned long long golden;
+    while (fscanf(file, "%llx", &golden) == 1) {
+        if (goldenFrames < frames && golden != frameHashes[goldenFrames]) {
+            firstMismatch = firstMismatch < 0 ? goldenFrames : firstMismatch;
+            mismatches++;
+        }
+        goldenFrames++;
+    }
+    fclose(file);
+
+    if (goldenFrames != frames)
+        printf("golden hashes: FAILED, %d golden frames for %d frames\n", goldenFrames, frames);
+    else if (mismatches > 0)
+        printf("golden hashes: FAILED, %d of %d frames differ, the first at frame %d\n", mismatches, frames, firstMismatch);
+    else
+        printf("golden hashes: all %d frames match\n", frames);
+    return goldenFrames == frames && mismatches == 0;
+}
+
+int compareSamples(const void* a, const void* b) {
+    const long long x = *(const long long*)a;
+    const long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+long long stageTotal(int stage, int frames) {
+    long long total = 0;
+    for (int i = 0; i < frames; i++)
+        total += benchSamples[stage][i];
+    return total;
+}
+
+void printStageSummary(int stage, int frames) {
+    long long* samples = benchSamples[stage];
+    long long total = stageTotal(stage, frames);
+
+    qsort(samples, frames, sizeof(long long), compareSamples);
+    int p99 = (frames * 99 + 99) / 100 - 1;
+    printf("%-24s %12lld %12lld %12lld %12lld\n",
+        benchStageNames[stage],
+        samples[0],
+        samples[frames / 2],
+        samples[p99 < frames ? p99 : frames - 1],
+        total / frames
+    );
+}
+
+void generateMap(int numCols, int numRows, unsigned int seed, int hasBorder) {
+    // Walls around the border (unless it's left open) and sparsely scattered pillars, leaving the player's
+    // starting point open:
+    MapCell* cells = (MapCell*) malloc(sizeof(MapCell) * (size_t)numCols * (size_t)numRows);
+    unsigned int random = seed ? seed : 1;
+    for (int row = 0; row < numRows; row++) {
+        for (int column = 0; column < numCols; column++) {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            int isBorder = hasBorder && (row == 0 || column == 0 || row == numRows - 1 || column == numCols - 1);
+            int isStart = abs(row - numRows / 2) < 2 && abs(column - numCols / 2) < 2;
+            MapCell content = (random % 256) == 0 ? (MapCell)(1 + (random >> 8) % NUM_TEXTURES) : 0;
+            cells[(size_t)row * numCols + column] = isBorder ? 1 : (isStart ? 0 : content);
+        }
+    }
+    setMap(numCols, numRows, cells);
+    free(cells);
+}
+
+void parseBenchOptions(int argc, char** argv) {
+    benchOptions.frames = BENCH_DEFAULT_FRAMES;
+    benchOptions.hashFrames = FALSE;
+    benchOptions.fused = FALSE;
+    benchOptions.paced = FALSE;
+    benchOptions.views = 0;
+    benchOptions.depthOnly = FALSE;
+    benchOptions.sprites = 0;
+    benchOptions.pathName = "default";
+    benchOptions.path = benchPath;
+    benchOptions.pathLength = BENCH_PATH_LENGTH(benchPath);
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+            benchOptions.frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            numWorkers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--packet-width") && i + 1 < argc)
+            maxPacketWidth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--map") && i + 1 < argc) {
+            if (!loadMap(argv[++i]))
+                exit(1);
+        } else if (!strcmp(argv[i], "--write-map") && i + 3 < argc) {
+            const char* path = argv[++i];
+            const int numCols = atoi(argv[++i]);
+            const int numRows = atoi(argv[++i]);
+            if (numCols < 3 || numRows < 3) {
+                fprintf(stderr, "Error: a map needs at least 3 columns and rows.\n");
+                exit(1);
+            }
+            generateMap(numCols, numRows, 2024, TRUE);
+            exit(saveMap(path) ? 0 : 1);
+        } else if (!strcmp(argv[i], "--open-map") && i + 2 < argc) {
+            // A generated map without walls around its border, so that rays run off its edge:
+            const int numCols = atoi(argv[++i]);
+            const int numRows = atoi(argv[++i]);
+            if (numCols < 3 || numRows < 3) {
+                fprintf(stderr, "Error: a map needs at least 3 columns and rows.\n");
+                exit(1);
+            }
+            generateMap(numCols, numRows, 2024, FALSE);
+        } else if (!strcmp(argv[i], "--hash"))
+            benchOptions.hashFrames = TRUE;
+        else if (!strcmp(argv[i], "--fused"))
+            benchOptions.fused = TRUE;
+        else if (!strcmp(argv[i], "--paced") && i + 1 < argc) {
+            benchOptions.paced = TRUE;
+            framesPerSecond = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--spin"))
+            framePacing = FRAME_PACING_SPIN;
+        else if (!strcmp(argv[i], "--row-major"))
+            isColumnMajorProjection = FALSE;
+        else if (!strcmp(argv[i], "--ray-stride") && i + 1 < argc)
+            setRayStride(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--nearest-rays"))
+            camera.rayFill = RAY_FILL_NEAREST;
+        else if (!strcmp(argv[i], "--frame-budget") && i + 1 < argc)
+            startResolutionController(atof(argv[++i]));
+        else if (!strcmp(argv[i], "--views") && i + 1 < argc)
+            benchOptions.views = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--depth-only"))
+            benchOptions.depthOnly = TRUE;
+        else if (!strcmp(argv[i], "--sprites") && i + 1 < argc)
+            benchOptions.sprites = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--doors") && i + 1 < argc)
+            benchOptions.doors = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--agents") && i + 1 < argc)
+            benchOptions.agents = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--low-walls") && i + 1 < argc)
+            benchOptions.lowWalls = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--shading") && i + 1 < argc) {
+            if ((lighting.shading = parseShading(argv[++i])) < 0)
+                exit(1);
+        }
+        else if (!strcmp(argv[i], "--stream") && i + 1 < argc)
+            benchOptions.streamAddress = argv[++i];
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+            benchOptions.recordingPath = argv[++i];
+        else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+            benchOptions.replayPath = argv[++i];
+        else if (!strcmp(argv[i], "--write-golden") && i + 1 < argc) {
+            benchOptions.goldenPath = argv[++i];
+            benchOptions.isCheckingGolden = FALSE;
+        } else if (!strcmp(argv[i], "--check-golden") && i + 1 < argc) {
+            benchOptions.goldenPath = argv[++i];
+            benchOptions.isCheckingGolden = TRUE;
+        } else if (!strcmp(argv[i], "--dump-frame") && i + 2 < argc && benchOptions.dumpedFrames < BENCH_MAX_DUMPED_FRAMES) {
+            benchOptions.dumpFrames[benchOptions.dumpedFrames] = atoi(argv[++i]);
+            benchOptions.dumpPaths[benchOptions.dumpedFrames++] = argv[++i];
+        }
+#ifdef PROFILE
+        else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+            openProfileTrace(argv[++i]);
+#endif
+        else if (!strcmp(argv[i], "--coherent"))
+            coherence.isEnabled = TRUE;
+        else if (!strcmp(argv[i], "--path") && i + 1 < argc && !strcmp(argv[i + 1], "default"))
+            benchOptions.pathName = argv[++i];
+        else if (!strcmp(argv[i], "--path") && i + 1 < argc && !strcmp(argv[i + 1], "idle")) {
+            benchOptions.pathName = argv[++i];
+            benchOptions.path = benchIdlePath;
+            benchOptions.pathLength = BENCH_PATH_LENGTH(benchIdlePath);
+        } else if (!strcmp(argv[i], "--path") && i + 1 < argc && !strcmp(argv[i + 1], "turning")) {
+            benchOptions.pathName = argv[++i];
+            benchOptions.path = benchTurningPath;
+            benchOptions.pathLength = BENCH_PATH_LENGTH(benchTurningPath);
+        } else {
+            fprintf(stderr, "Usage: %s [--frames N] [--threads N] [--packet-width 1|4|8] [--fused] [--row-major] [--hash]\n"
+                            "       [--ray-stride N] [--nearest-rays] [--frame-budget MS] [--coherent] [--path default|idle|turning]\n"
+                            "       [--views N] [--depth-only] [--sprites N] [--doors N] [--agents N] [--low-walls PERCENT]\n"
+                            "       [--shading none|colormap|naive] [--paced FPS [--spin]]\n"
+                            "       [--map FILE | --open-map COLUMNS ROWS] [--write-map FILE COLUMNS ROWS] [--stream unix:PATH|tcp:PORT]\n"
+                            "       [--record FILE | --replay FILE] [--write-golden FILE | --check-golden FILE] [--dump-frame N FILE.ppm]\n"
+                            "       [--trace FILE (with PROFILE)]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (benchOptions.frames < 1)
+        benchOptions.frames = 1;
+}
+
+int main(int argc, char** argv) {
+    parseBenchOptions(argc, argv);
+    setup();
+
+    // Doors opening and closing all the time (e.g: --doors 50 --path idle --coherent, for the map edits):
+    if (benchOptions.doors > 0 && !scatterDoors(benchOptions.doors, 2024))
+        exit(1);
+    // Walls to see over (e.g: --low-walls 50, with and without --coherent):
+    int lowWalls = 0;
+    if (benchOptions.lowWalls > 0 && (lowWalls = lowerWalls(benchOptions.lowWalls, 2024)) < 0)
+        exit(1);
+    // Crowds walking all over the map (e.g: --agents 100000 --threads 1 --packet-width 1, against the defaults):
+    if (benchOptions.agents > 0 && !scatterAgents(benchOptions.agents, 2024))
+        exit(1);
+
+    // A replay has as many frames as were recorded, and needs the map it was recorded on:
+    if (benchOptions.replayPath) {
+        if (!loadRecording(benchOptions.replayPath))
+            exit(1);
+        benchOptions.frames = recording.frames > 0 ? recording.frames : 1;
+        benchOptions.pathName = benchOptions.replayPath;
+    }
+    if (benchOptions.recordingPath && !startRecording(benchOptions.recordingPath, BENCH_DELTA_TIME))
+        exit(1);
+    const int frames = benchOptions.frames;
+    if (benchOptions.goldenPath && !(frameHashes = (unsigned long long*) calloc(frames, sizeof(unsigned long long)))) {
+        fprintf(stderr, "Error allocating the frame hashes.\n");
+        exit(1);
+    }
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+        benchSamples[stage] = (long long*) malloc(sizeof(long long) * frames);
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+        benchStageMeasured[stage] = TRUE;
+    if (benchOptions.fused)
+        benchStageMeasured[STAGE_CAST_ALL_RAYS] = benchStageMeasured[STAGE_PROJECTION] = FALSE;
+    else
+        benchStageMeasured[STAGE_CAST_AND_PROJECT] = FALSE;
+    benchStageMeasured[STAGE_RENDER_VIEWS] = benchOptions.views > 0;
+
+    // Sprites are scattered over the whole map, whichever it is (e.g: --sprites 10000 for a crowded scene):
+    if (benchOptions.sprites > 0 && !scatterSprites(benchOptions.sprites, 2024))
+        exit(1);
+
+    // Depth-only runs project every view into depth columns, and fill no pixels at all:
+    if (benchOptions.depthOnly)
+        playerView.depthColumns = &playerDepthColumns;
+
+    // Batches of views are rendered from the player's position each frame, looking all around it:
+    struct CameraState* cameras = NULL;
+    if (benchOptions.views > 0) {
+        cameras = (struct CameraState*) calloc(benchOptions.views, sizeof(struct CameraState));
+        for (int i = 0; i < benchOptions.views; i++) {
+            void* pixels = NULL;
+            if (!cameras || (benchOptions.depthOnly ?
+                    !(cameras[i].depthColumns = (struct DepthColumns*) malloc(sizeof(struct DepthColumns))) :
+                    posix_memalign(&pixels, 64, sizeof(Uint32) * (size_t)WINDOW_WIDTH * WINDOW_HEIGHT) != 0)) {
+                fprintf(stderr, "Error allocating the views.\n");
+                exit(1);
+            }
+            cameras[i].pixels = (Uint32*) pixels;
+        }
+    }
+
+    // Paced runs wait for each frame like the game loop does, to measure the scheduler's CPU use and jitter
+    // (the simulation still steps by BENCH_DELTA_TIME per frame, so frames stay the same):
+    if (benchOptions.paced) {
+        startScheduler(framePacing, framesPerSecond);
+        scheduler.reportLength = LLONG_MAX; // a single report for the whole run
+    }
+#ifdef PROFILE
+    profile.reportLength = LLONG_MAX;
+#endif
+
+    int step = 0;
+    int stepFrame = 0;
+    // The viewer has to connect before the first frame (depth-only runs have no pixels to stream):
+    if (benchOptions.streamAddress && (benchOptions.depthOnly || !startStream(benchOptions.streamAddress))) {
+        if (benchOptions.depthOnly)
+            fprintf(stderr, "Error: depth-only frames can't be streamed.\n");
+        exit(1);
+    }
+
+    long long rayStrides = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        player.walkDirection = benchOptions.path[step].walkDirection;
+        player.turnDirection = benchOptions.path[step].turnDirection;
+        if (++stepFrame == benchOptions.path[step].frames) {
+            stepFrame = 0;
+            step = (step + 1) % benchOptions.pathLength;
+        }
+
+        PROFILE_FRAME_BEGIN();
+        long long start = benchNow();
+        if (benchOptions.replayPath)
+            replayFrame(frame);
+        else
+            tickSimulation(BENCH_DELTA_TIME);
+        long long moved = benchNow();
+        if (recording.file)
+            recordFrame(1);
+        long long cast = moved;
+        if (benchOptions.fused)
+            castAndProjectAllRays();
+        else {
+            castAllRays();
+            cast = benchNow();
+            generate3DProjection();
+        }
+        long long projected = benchNow();
+        rayStrides += camera.rayStride;
+        adjustRayStride(projected - moved);
+
+        long long viewsStart = benchNow();
+        for (int i = 0; i < benchOptions.views; i++) {
+            // Rotation amounts from -1 to 1 cover half a turn, and every other view looks the opposite way:
+            cameras[i].position = player.position;
+            cameras[i].orientation = player.orientation;
+            rotate(&cameras[i].orientation, -1 + 2.0f * (i / 2) / ((benchOptions.views + 1) / 2));
+            if (i & 1) {
+                cameras[i].orientation.x = -cameras[i].orientation.x;
+                cameras[i].orientation.y = -cameras[i].orientation.y;
+            }
+        }
+        if (benchOptions.views > 0)
+            renderViews(cameras, benchOptions.views);
+        benchSamples[STAGE_RENDER_VIEWS][frame] = benchNow() - viewsStart;
+
+        if (benchOptions.hashFrames && benchOptions.depthOnly) {
+            hashDepthColumns(&benchHash, &playerDepthColumns);
+            for (int i = 0; i < benchOptions.views; i++)
+                hashDepthColumns(&benchHash, cameras[i].depthColumns);
+        } else if (benchOptions.hashFrames) {
+            hashPixels(&benchHash, colorBuffer);
+            for (int i = 0; i < benchOptions.views; i++)
+                hashPixels(&benchHash, cameras[i].pixels);
+        }
+        if (frameHashes) {
+            frameHashes[frame] = FNV_OFFSET_BASIS;
+            if (benchOptions.depthOnly)
+                hashDepthColumns(&frameHashes[frame], &playerDepthColumns);
+            else
+                hashPixels(&frameHashes[frame], colorBuffer);
+        }
+        for (int i = 0; i < benchOptions.dumpedFrames; i++)
+            if (benchOptions.dumpFrames[i] == frame && !benchOptions.depthOnly && !writePPM(benchOptions.dumpPaths[i], colorBuffer))
+                exit(1);
+        if (stream.socket >= 0)
+            streamFrame(colorBuffer, frame, projected);
+        PROFILE_FRAME_END(player.position.x, player.position.y);
+        if (benchOptions.paced)
+            waitForNextFrame();
+
+        benchSamples[STAGE_TICK_SIMULATION][frame] = moved - start;
+        if (benchOptions.fused)
+            benchSamples[STAGE_CAST_AND_PROJECT][frame] = projected - moved;
+        else {
+            benchSamples[STAGE_CAST_ALL_RAYS][frame] = cast - moved;
+            benchSamples[STAGE_PROJECTION][frame] = projected - cast;
+        }
+        benchSamples[STAGE_FRAME][frame] = projected - start;
+    }
+
+    const double castSeconds = stageTotal(benchOptions.fused ? STAGE_CAST_AND_PROJECT : STAGE_CAST_ALL_RAYS, frames) / 1e9;
+    const double projectionSeconds = stageTotal(benchOptions.fused ? STAGE_CAST_AND_PROJECT : STAGE_PROJECTION, frames) / 1e9;
+    const double frameSeconds = stageTotal(STAGE_FRAME, frames) / 1e9;
+    const double frameBytes = sizeof(Uint32) * (double)WINDOW_WIDTH * WINDOW_HEIGHT;
+
+    printf("Headless benchmark: %d frames, %dx%d, %d rays per frame, %d workers, %s kernel, %dx%d map, %s projection, %s path\n",
+        frames, WINDOW_WIDTH, WINDOW_HEIGHT, NUM_RAYS, workers.count, packetKernelName, map.numCols, map.numRows,
+        benchOptions.depthOnly ? "depth-only" : (isColumnMajorProjection ? transposeKernelName : "row-major"),
+        benchOptions.pathName);
+    printf("%-24s %12s %12s %12s %12s\n", "stage", "min(ns)", "median(ns)", "p99(ns)", "mean(ns)");
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+        if (benchStageMeasured[stage])
+            printStageSummary(stage, frames);
+
+    printf("rays/sec:   %.0f\n", (double)NUM_RAYS * frames / castSeconds);
+    if (benchOptions.depthOnly)
+        printf("depth columns: %.2f KB/frame\n", sizeof(struct DepthColumns) / 1e3);
+    else {
+        printf("pixels/sec: %.0f\n", (double)WINDOW_WIDTH * WINDOW_HEIGHT * frames / projectionSeconds);
+        // Every pixel of colorBuffer is written exactly once per frame, since it's no longer cleared:
+        printf("colorBuffer writes: %.2f MB/frame, %.2f GB/s\n", frameBytes / 1e6, frameBytes * frames / projectionSeconds / 1e9);
+    }
+    printf("frames/sec: %.1f\n", frames / frameSeconds);
+    if (benchOptions.views > 0)
+        printf("views/sec: %.1f (%d per batch)\n",
+            (double)benchOptions.views * frames / (stageTotal(STAGE_RENDER_VIEWS, frames) / 1e9), benchOptions.views);
+    if (resolution.isEnabled)
+        printf("adaptive ray stride: %.2f on average, %d at the end, %d changes (%.2fms target)\n",
+            (double)rayStrides / frames, camera.rayStride, resolution.changes, resolution.targetFrameTime / 1e6);
+    else if (camera.rayStride > 1)
+        printf("ray stride: %d\n", camera.rayStride);
+    if (coherence.isEnabled)
+        printCoherenceReport();
+    if (sprites.count > 0)
+        printf("sprites: %d, %d visible in the last frame\n", sprites.count, sprites.visibleCount);
+    if (lighting.shading != SHADING_NONE)
+        printf("shading: %s, %d light levels\n", shadingNames[lighting.shading], NUM_LIGHT_LEVELS);
+    if (thinWalls.count > 0)
+        printf("thin walls: %d, %d opening or closing\n", thinWalls.count, thinWalls.moving);
+    if (lowWalls > 0) {
+        int columns = 0, walls = 0;
+        for (int i = 0; i < NUM_RAYS; i++) {
+            columns += rayHits[i].count > 0;
+            walls += rayHits[i].count;
+        }
+        printf("low walls: %d, %d columns seeing over them in the last frame, %.2f walls each\n",
+            lowWalls, columns, columns > 0 ? (double)walls / columns : 0.0);
+    }
+    if (benchOptions.hashFrames)
+        printf("frame hash: %016llx\n", benchHash);
+    if (agents.count > 0) {
+        printAgentReport();
+        if (benchOptions.hashFrames) {
+            unsigned long long agentHash = FNV_OFFSET_BASIS;
+            hashBytes(&agentHash, agents.x, sizeof(float) * agents.count);
+            hashBytes(&agentHash, agents.y, sizeof(float) * agents.count);
+            printf("agent hash: %016llx\n", agentHash);
+        }
+    }
+    if (benchOptions.paced)
+        printSchedulerReport(clockNanoseconds(CLOCK_MONOTONIC));
+    if (stream.frames > 0)
+        printStreamReport();
+    PROFILE_STOP();
+
+    int isGolden = TRUE;
+    if (benchOptions.goldenPath)
+        isGolden = benchOptions.isCheckingGolden ?
+            checkGoldenHashes(benchOptions.goldenPath, frames) : writeGoldenHashes(benchOptions.goldenPath, frames);
+    if (recording.file && stopRecording())
+        printf("recorded %d frames to %s\n", recording.frames, benchOptions.recordingPath);
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+        free(benchSamples[stage]);
+    for (int i = 0; i < benchOptions.views; i++) {
+        free(cameras[i].pixels);
+        free(cameras[i].depthColumns);
+    }
+    free(cameras);
+    stopWorkers();
+    free(colorBuffer);
+    freeTextures();
+    freeColormaps();
+    freeSprites();
+    freeThinWalls();
+    freeAgents();
+    freeRecording();
+    stopStream();
+    free(frameHashes);
+    unloadMap();
+
+    return isGolden ? 0 : 1;
+}
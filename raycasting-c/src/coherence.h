@@ -0,0 +1,203 @@
+// Frame coherence cache:
+// =========
+// When the player hasn't moved or turned since the last frame (and the map hasn't changed), rays[] and
+// colorBuffer already hold this frame, so casting and projecting are skipped altogether.
+// Ray directions are the player's orientation rotated by each column's rotation amount, so turning by whole
+// multiples of the ray step turns each ray into the direction one of its neighbours had in the last frame. With
+// the cache enabled, movePlayer() turns in whole ray steps (carrying whatever is left over to the next tick,
+// so the turn rate is kept on average), and on a turn without moving, the cast results in rays[] are shifted
+// over by as many columns, and only the columns that came into view are cast.
+// Walls are still projected on every column, since their height depends on the angle from the orientation.
+// When the map is edited while the player stands still (e.g: a door opening), only the rays whose way from the
+// player to their wall crosses an edited region are cast again, and only their tiles are projected again
+// (for rays seeing over low walls, the way goes on to where they stopped, see heights.h).
+// Casting on fewer columns than all (see camera.rayStride) spaces rays unevenly, so turns aren't reused then.
+#include <string.h>
+
+struct CoherenceCache {
+    int isEnabled;
+    int isValid; // whether rays[] and colorBuffer hold the frame of the position and orientation below
+    vec2 position;
+    vec2 orientation;
+    unsigned int mapVersion;
+    int rayStride;
+    int turnedSteps;     // whole ray steps turned since the last frame
+    float turnRemainder; // the part of the turns not yet done, less than half a ray step
+
+    // The current frame:
+    int isFrameSkipped;
+    int firstCastStrip; // the strips of the player's view cast this frame
+    int lastCastStrip;
+    int firstProjectedStrip; // and the strips projected (the tiles they're in)
+    int lastProjectedStrip;
+
+    // Counters (of frames, and of rays):
+    long long idleHits;
+    long long turnHits;
+    long long editHits;
+    long long misses;
+    long long reusedRays;
+    long long castRays;
+} coherence;
+
+// The rotation amounts of turning by 0 to NUM_RAYS whole ray steps:
+float ray_step_amounts[NUM_RAYS + 1];
+
+void setRayStepAmounts() {
+    ray_step_amounts[0] = 0;
+    for (int steps = 1; steps <= NUM_RAYS; steps++)
+        ray_step_amounts[steps] = addRotationAmounts(ray_step_amounts[steps - 1], camera.rayStep);
+}
+
+void invalidateCoherenceCache() {
+    coherence.isValid = FALSE;
+}
+
+void turnByRaySteps(float amount) {
+    // Rounds the turn to the nearest whole number of ray steps (small amounts add up nearly linearly):
+    const float total = amount + coherence.turnRemainder;
+    int steps = (int)lrintf(total / camera.rayStep);
+    steps = steps > NUM_RAYS ? NUM_RAYS : (steps < -NUM_RAYS ? -NUM_RAYS : steps);
+    const float stepsAmount = steps >= 0 ? ray_step_amounts[steps] : -ray_step_amounts[-steps];
+
+    coherence.turnRemainder = total - stepsAmount;
+    if (steps) {
+        rotate(&player.orientation, stepsAmount);
+        coherence.turnedSteps += steps;
+    }
+}
+
+const vec2* rayEnd(int stripId) {
+    // Where the player's ray stopped:
+    return map.heights && rayHits[stripId].count > 0 ? &rayHits[stripId].end : &rays[stripId].wallHit;
+}
+
+int rayCrossesRegion(const vec2* end, const struct MapRegion* region) {
+    // Whether the way from the player to the end of a ray touches the region's cells (clipping it to each axis'
+    // slab in turn, with the ray's end at 1):
+    const float origin[2] = {player.position.x, player.position.y};
+    const float delta[2] = {end->x - player.position.x, end->y - player.position.y};
+    const float low[2] = {(float)region->firstColumn * TILE_SIZE, (float)region->firstRow * TILE_SIZE};
+    const float high[2] = {(float)(region->lastColumn + 1) * TILE_SIZE, (float)(region->lastRow + 1) * TILE_SIZE};
+    float first = 0, last = 1;
+    for (int axis = 0; axis < 2; axis++) {
+        if (delta[axis] == 0) {
+            if (origin[axis] < low[axis] || origin[axis] > high[axis])
+                return FALSE;
+            continue;
+        }
+        float enter = (low[axis] - origin[axis]) / delta[axis];
+        float exit = (high[axis] - origin[axis]) / delta[axis];
+        if (enter > exit) {
+            const float swap = enter;
+            enter = exit;
+            exit = swap;
+        }
+        first = enter > first ? enter : first;
+        last = exit < last ? exit : last;
+        if (first > last)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+int rayCrossesEdits(int stripId, int edits) {
+    for (int i = 0; i < edits; i++)
+        if (rayCrossesRegion(rayEnd(stripId), getMapEdit(i)))
+            return TRUE;
+    return FALSE;
+}
+
+void setEditedCastRange(int edits) {
+    // The strips between the first and the last ray crossing one of the last edits of the map:
+    int first = 0, last = NUM_RAYS;
+    while (first < last && !rayCrossesEdits(first, edits))
+        first++;
+    while (last > first && !rayCrossesEdits(last - 1, edits))
+        last--;
+    coherence.firstCastStrip = first;
+    coherence.lastCastStrip = last;
+    coherence.firstProjectedStrip = first;
+    coherence.lastProjectedStrip = last;
+}
+
+void beginCoherentFrame() {
+    // Decides how much of the last frame can be reused, shifting rays[] when the player only turned, and
+    // casting only what the map's edits could have changed when the player didn't move at all:
+    const int isStill = coherence.isValid && coherence.rayStride == camera.rayStride &&
+        coherence.position.x == player.position.x && coherence.position.y == player.position.y;
+    const int isSameMap = coherence.mapVersion == map.version;
+    const int steps = coherence.turnedSteps;
+    const int isSameOrientation = steps == 0 &&
+        coherence.orientation.x == player.orientation.x && coherence.orientation.y == player.orientation.y;
+    const int edits = isSameMap ? 0 : countMapEditsSince(coherence.mapVersion);
+
+    coherence.isFrameSkipped = FALSE;
+    coherence.firstCastStrip = coherence.firstProjectedStrip = 0;
+    coherence.lastCastStrip = coherence.lastProjectedStrip = NUM_RAYS;
+    if (coherence.isEnabled && isStill && isSameMap && isSameOrientation) {
+        coherence.isFrameSkipped = TRUE;
+        coherence.idleHits++;
+        coherence.reusedRays += NUM_RAYS;
+    } else if (coherence.isEnabled && isStill && isSameMap && steps != 0 && abs(steps) < NUM_RAYS && camera.rayStride == 1) {
+        // Turning by +steps makes ray i what ray (i + steps) was:
+        if (steps > 0) {
+            memmove(&rays[0], &rays[steps], sizeof(struct Ray) * (NUM_RAYS - steps));
+            if (map.heights)
+                memmove(&rayHits[0], &rayHits[steps], sizeof(struct RayHits) * (NUM_RAYS - steps));
+            coherence.firstCastStrip = NUM_RAYS - steps;
+        } else {
+            memmove(&rays[-steps], &rays[0], sizeof(struct Ray) * (NUM_RAYS + steps));
+            if (map.heights)
+                memmove(&rayHits[-steps], &rayHits[0], sizeof(struct RayHits) * (NUM_RAYS + steps));
+            coherence.lastCastStrip = -steps;
+        }
+        coherence.turnHits++;
+        coherence.reusedRays += NUM_RAYS - abs(steps);
+        coherence.castRays += abs(steps);
+    } else if (coherence.isEnabled && isStill && isSameOrientation && edits > 0 && camera.rayStride == 1) {
+        setEditedCastRange(edits);
+        coherence.isFrameSkipped = coherence.firstCastStrip == coherence.lastCastStrip;
+        coherence.editHits++;
+        coherence.reusedRays += NUM_RAYS - (coherence.lastCastStrip - coherence.firstCastStrip);
+        coherence.castRays += coherence.lastCastStrip - coherence.firstCastStrip;
+    } else {
+        if (coherence.isEnabled)
+            coherence.misses++;
+        coherence.castRays += NUM_RAYS;
+    }
+
+    coherence.isValid = TRUE;
+    coherence.position = player.position;
+    coherence.orientation = player.orientation;
+    coherence.mapVersion = map.version;
+    coherence.rayStride = camera.rayStride;
+    coherence.turnedSteps = 0;
+}
+
+void getTileCastRange(int firstStrip, int lastStrip, int* firstCastStrip, int* lastCastStrip) {
+    // The strips of a tile that still need casting (of the player's view, the only one cached):
+    *firstCastStrip = firstStrip;
+    *lastCastStrip = lastStrip;
+    if (view != &playerView)
+        return;
+    *firstCastStrip = coherence.firstCastStrip > firstStrip ? coherence.firstCastStrip : firstStrip;
+    *lastCastStrip = coherence.lastCastStrip < lastStrip ? coherence.lastCastStrip : lastStrip;
+    if (*firstCastStrip > *lastCastStrip)
+        *firstCastStrip = *lastCastStrip = firstStrip;
+}
+
+int isTileProjected(int firstStrip, int lastStrip) {
+    // Whether a tile of the player's view has to be projected again:
+    return view != &playerView ||
+        (firstStrip < coherence.lastProjectedStrip && lastStrip > coherence.firstProjectedStrip);
+}
+
+void printCoherenceReport() {
+    const long long frames = coherence.idleHits + coherence.turnHits + coherence.editHits + coherence.misses;
+    const long long rays = coherence.reusedRays + coherence.castRays;
+    printf("coherence cache: %lld idle hits, %lld turn hits, %lld map edit hits, %lld misses (of %lld frames), %.1f%% of rays reused\n",
+        coherence.idleHits, coherence.turnHits, coherence.editHits, coherence.misses, frames,
+        rays > 0 ? 100.0 * coherence.reusedRays / rays : 0.0);
+}
+// =========
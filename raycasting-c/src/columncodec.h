@@ -0,0 +1,150 @@
+// Column delta codec:
+// =========
+// Frames are streamed (see stream.h) as the columns that changed since the previous frame, each column coded
+// against the same column of the previous frame, from top to bottom, as a sequence of tokens:
+//   COLUMN_SKIP    count pixels the same as in the previous frame (a coherent frame reuses most of them)
+//   COLUMN_REPEAT  count pixels of one color, followed by the color
+//   COLUMN_LITERAL count pixels, followed by each of their colors
+// Each token is a 16 bit little-endian word, with its kind in the top 2 bits and its count in the other 14.
+// A frame message is a StreamFrameHeader, then for each changed column, its 16 bit index and its tokens, which
+// always cover the column's whole height. Columns that didn't change at all aren't sent.
+// A stream starts with a StreamHeader, and its first frame is coded against a black frame.
+// This header is shared by the renderer and the viewer (viewer/viewer.c), so it only needs the C library.
+#include <stdint.h>
+#include <string.h>
+
+#define STREAM_MAGIC "RSTR"
+#define STREAM_VERSION 1
+#define COLUMN_SKIP 0
+#define COLUMN_REPEAT 1
+#define COLUMN_LITERAL 2
+#define COLUMN_TOKEN_COUNT_BITS 14
+#define COLUMN_MAX_TOKEN_COUNT ((1 << COLUMN_TOKEN_COUNT_BITS) - 1)
+#define COLUMN_MIN_REPEAT 3 // the shortest run coded as a repeat rather than as literals
+// The most a column can take (a token every pixel, in the worst case, besides each pixel's color):
+#define COLUMN_MAX_CODED_SIZE(height) (2 + (size_t)(height) * 6)
+
+struct StreamHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct StreamFrameHeader {
+    uint32_t frame;
+    uint32_t columns;     // how many changed columns follow
+    uint32_t payloadSize; // in bytes, after this header
+    uint32_t rawSize;     // of the frame's pixels, for the compression ratio
+    uint64_t renderedAt;  // when the frame was rendered, in monotonic nanoseconds (for the latency on one machine)
+};
+
+unsigned char* putColumnToken(unsigned char* out, int kind, int count) {
+    const uint16_t token = (uint16_t)((kind << COLUMN_TOKEN_COUNT_BITS) | count);
+    out[0] = (unsigned char)(token & 0xFF);
+    out[1] = (unsigned char)(token >> 8);
+    return out + 2;
+}
+
+unsigned char* putColumnColors(unsigned char* out, const uint32_t* column, int stride, int count) {
+    for (int i = 0; i < count; i++) {
+        const uint32_t color = column[(size_t)i * stride];
+        out[0] = (unsigned char)(color & 0xFF);
+        out[1] = (unsigned char)((color >> 8) & 0xFF);
+        out[2] = (unsigned char)((color >> 16) & 0xFF);
+        out[3] = (unsigned char)(color >> 24);
+        out += 4;
+    }
+    return out;
+}
+
+int runLength(const uint32_t* column, int stride, int y, int height) {
+    // The number of pixels from y with the same color as y's:
+    int end = y + 1;
+    while (end < height && end - y < COLUMN_MAX_TOKEN_COUNT && column[(size_t)end * stride] == column[(size_t)y * stride])
+        end++;
+    return end - y;
+}
+
+size_t encodeColumn(unsigned char* out, int index, uint32_t* previous, const uint32_t* column, int stride, int height) {
+    // Codes a column of pixels stride pixels apart against the same column of the previous frame (which is then
+    // updated), returning the size it took, or 0 if it hasn't changed at all:
+    unsigned char* start = out;
+    out[0] = (unsigned char)(index & 0xFF);
+    out[1] = (unsigned char)(index >> 8);
+    out += 2;
+    int isChanged = FALSE;
+    int y = 0;
+    while (y < height) {
+        int end = y;
+        while (end < height && end - y < COLUMN_MAX_TOKEN_COUNT && column[(size_t)end * stride] == previous[(size_t)end * stride])
+            end++;
+        if (end > y) {
+            out = putColumnToken(out, COLUMN_SKIP, end - y);
+            y = end;
+            continue;
+        }
+        isChanged = TRUE;
+        const int run = runLength(column, stride, y, height);
+        if (run >= COLUMN_MIN_REPEAT) {
+            out = putColumnToken(out, COLUMN_REPEAT, run);
+            out = putColumnColors(out, &column[(size_t)y * stride], stride, 1);
+            end = y + run;
+        } else {
+            // Literals up to the next pixel that's unchanged, or that starts a repeat:
+            end = y + 1;
+            while (end < height && end - y < COLUMN_MAX_TOKEN_COUNT &&
+                   column[(size_t)end * stride] != previous[(size_t)end * stride] &&
+                   runLength(column, stride, end, height) < COLUMN_MIN_REPEAT)
+                end++;
+            out = putColumnToken(out, COLUMN_LITERAL, end - y);
+            out = putColumnColors(out, &column[(size_t)y * stride], stride, end - y);
+        }
+        for (; y < end; y++)
+            previous[(size_t)y * stride] = column[(size_t)y * stride];
+    }
+    return isChanged ? (size_t)(out - start) : 0;
+}
+
+size_t decodeColumns(const unsigned char* in, size_t size, int columns, uint32_t* pixels, int width, int height) {
+    // Decodes a frame's changed columns over the previous frame in row-major pixels, returning the size read,
+    // or 0 if the payload isn't valid:
+    const unsigned char* start = in;
+    const unsigned char* end = in + size;
+    for (int c = 0; c < columns; c++) {
+        if (end - in < 2)
+            return 0;
+        const int index = in[0] | (in[1] << 8);
+        in += 2;
+        if (index >= width)
+            return 0;
+        uint32_t* column = &pixels[index];
+        int y = 0;
+        while (y < height) {
+            if (end - in < 2)
+                return 0;
+            const int token = in[0] | (in[1] << 8);
+            const int kind = token >> COLUMN_TOKEN_COUNT_BITS;
+            const int count = token & COLUMN_MAX_TOKEN_COUNT;
+            in += 2;
+            if (count == 0 || y + count > height)
+                return 0;
+            if (kind == COLUMN_REPEAT || kind == COLUMN_LITERAL) {
+                const size_t colors = kind == COLUMN_REPEAT ? 1 : (size_t)count;
+                if ((size_t)(end - in) < colors * 4)
+                    return 0;
+                for (int i = 0; i < count; i++) {
+                    const unsigned char* color = kind == COLUMN_REPEAT ? in : in + (size_t)i * 4;
+                    column[(size_t)(y + i) * width] =
+                        (uint32_t)color[0] | ((uint32_t)color[1] << 8) | ((uint32_t)color[2] << 16) | ((uint32_t)color[3] << 24);
+                }
+                in += colors * 4;
+            } else if (kind != COLUMN_SKIP) {
+                return 0;
+            }
+            y += count;
+        }
+    }
+    return (size_t)(in - start);
+}
+// =========
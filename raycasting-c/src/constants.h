@@ -2,19 +2,25 @@
 #define TRUE 1
 
 #define TILE_SIZE 64
+
+// The size of the built-in map (maps loaded from a file can be of any size)
 #define MAP_NUM_ROWS 13
 #define MAP_NUM_COLS 20
 #define NUM_TEXTURES 8
 
 #define MINIMAP_SCALE_FACTOR 0.2
 
-#define WINDOW_WIDTH (MAP_NUM_COLS * TILE_SIZE)
-#define WINDOW_HEIGHT (MAP_NUM_ROWS * TILE_SIZE)
+#define WINDOW_WIDTH 1280
+#define WINDOW_HEIGHT 832
 
 #define TEXTURE_WIDTH 64
 #define TEXTURE_HEIGHT 64
 
 #define NUM_RAYS WINDOW_WIDTH
+#define MAX_RAY_HITS 8 // walls seen by a ray over lower walls in front of them
+
+#define COLUMN_TILE_WIDTH 32
+#define NUM_COLUMN_TILES ((NUM_RAYS + COLUMN_TILE_WIDTH - 1) / COLUMN_TILE_WIDTH)
 
 #define FPS 30
 #define FRAME_TIME_LENGTH (1000 / FPS)
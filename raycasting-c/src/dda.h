@@ -0,0 +1,160 @@
+// Single-pass grid traversal kernel:
+// =========
+// An alternative to castRay() that visits the grid line touches of both axes in a single interleaved walk,
+// in the order the ray reaches them (Amanatides-Woo), stopping at the first wall instead of marching
+// all horizontal and then all vertical grid lines to completion.
+// The line being crossed is tracked as an integer index that steps by one, so there's no floor(), division or
+// bounds check against the map in pixels per step. Touch points advance exactly like they do in castRay(),
+// and the cell behind each touch is resolved the same way, so the hits (and image) are the same.
+// With the blocked map backend, the touches inside empty blocks are skipped without looking at any cells.
+// A thin wall's cell (see doors.h) ends the walk only if the ray hits the thin wall inside it (the view's own
+// cell is checked before walking).
+void castRayDDA(vec2* rayDir, int stripId) {
+    PROFILE_COUNT(rays, 1);
+    if (castViewCellThinWall(rayDir, stripId))
+        return;
+    int isRayFacingDown = rayDir->y > 0;
+    int isRayFacingRight = rayDir->x > 0;
+    int isRayFacingUp = !isRayFacingDown;
+    int isRayFacingLeft = !isRayFacingRight;
+
+    // The next horizontal grid line touch, the step between touches and the row behind the line:
+    int horzRow = (int)floor(view->position.y / TILE_SIZE) + (isRayFacingDown ? 1 : -1);
+    float nextHorzTouchY = (float)floor(view->position.y / TILE_SIZE) * TILE_SIZE + (isRayFacingDown ? TILE_SIZE : 0);
+    float nextHorzTouchX = view->position.x + (nextHorzTouchY - view->position.y) * view->raySlopes->xPerY[stripId];
+    float horzStepX = TILE_SIZE * view->raySlopes->xPerY[stripId];
+    horzStepX *= (isRayFacingLeft && horzStepX > 0) ? -1 : 1;
+    horzStepX *= (isRayFacingRight && horzStepX < 0) ? -1 : 1;
+    const float horzStepY = isRayFacingUp ? -TILE_SIZE : TILE_SIZE;
+    const int horzRowStep = isRayFacingUp ? -1 : 1;
+
+    // The next vertical grid line touch, the step between touches and the column behind the line:
+    int vertColumn = (int)floor(view->position.x / TILE_SIZE) + (isRayFacingRight ? 1 : -1);
+    float nextVertTouchX = (float)floor(view->position.x / TILE_SIZE) * TILE_SIZE + (isRayFacingRight ? TILE_SIZE : 0);
+    float nextVertTouchY = view->position.y + (nextVertTouchX - view->position.x) * view->raySlopes->yPerX[stripId];
+    float vertStepY = TILE_SIZE * view->raySlopes->yPerX[stripId];
+    vertStepY *= (isRayFacingUp && vertStepY > 0) ? -1 : 1;
+    vertStepY *= (isRayFacingDown && vertStepY < 0) ? -1 : 1;
+    const float vertStepX = isRayFacingLeft ? -TILE_SIZE : TILE_SIZE;
+    const int vertColumnStep = isRayFacingLeft ? -1 : 1;
+
+    // Which touch comes first along the ray is decided without dividing by the ray's components:
+    // |touchY - y| / |rayDir.y| < |touchX - x| / |rayDir.x|  <=>  |touchY - y| * |rayDir.x| < |touchX - x| * |rayDir.y|
+    const float rayDirX = fabsf(rayDir->x);
+    const float rayDirY = fabsf(rayDir->y);
+
+    int wasHitVertical = FALSE;
+    int isThinWallHit = FALSE;
+    int wallHitContent = 0;
+    float wallHitX = 0;
+    float wallHitY = 0;
+    for (;;) {
+        int row, column;
+        if (fabsf(nextVertTouchX - view->position.x) * rayDirY < fabsf(nextHorzTouchY - view->position.y) * rayDirX) {
+            if (nextVertTouchY < 0 || nextVertTouchY > map.height)
+                break;
+            row = (int)(nextVertTouchY / TILE_SIZE);
+            column = vertColumn;
+            PROFILE_COUNT(verticalSteps, 1);
+            wasHitVertical = TRUE;
+            wallHitX = nextVertTouchX;
+            wallHitY = nextVertTouchY;
+
+            nextVertTouchX += vertStepX;
+            nextVertTouchY += vertStepY;
+            vertColumn += vertColumnStep;
+        } else {
+            if (nextHorzTouchX < 0 || nextHorzTouchX > map.width)
+                break;
+            row = horzRow;
+            column = (int)(nextHorzTouchX / TILE_SIZE);
+            PROFILE_COUNT(horizontalSteps, 1);
+            wasHitVertical = FALSE;
+            wallHitX = nextHorzTouchX;
+            wallHitY = nextHorzTouchY;
+
+            nextHorzTouchX += horzStepX;
+            nextHorzTouchY += horzStepY;
+            horzRow += horzRowStep;
+        }
+        if (row < 0 || row >= map.numRows || column < 0 || column >= map.numCols) {
+            // A ray leaving an open map ends on the map's border, with no wall content
+            wallHitContent = 0;
+            break;
+        }
+
+#ifdef MAP_BLOCKED
+        wallHitContent = 0;
+        if (mapBlockIsEmpty(mapBlockAt(column, row))) {
+            // The ray just entered (or is still inside) a block without walls, so every following touch with its
+            // cell inside the block is skipped without a lookup, stopping at the first one outside on each axis.
+            // The cell behind each touch is still resolved from the touch itself, so corner cases go the same
+            // way they would have, and touches advance one step at a time so they round like castRay()'s:
+            const int blockColumn = column & ~MAP_BLOCK_MASK;
+            const int blockRow = row & ~MAP_BLOCK_MASK;
+            const int blockColumnEnd = blockColumn + MAP_BLOCK_SIZE < map.numCols ? blockColumn + MAP_BLOCK_SIZE : map.numCols;
+            const int blockRowEnd = blockRow + MAP_BLOCK_SIZE < map.numRows ? blockRow + MAP_BLOCK_SIZE : map.numRows;
+            while (vertColumn >= blockColumn && vertColumn < blockColumnEnd && nextVertTouchY >= 0 &&
+                   (int)(nextVertTouchY / TILE_SIZE) >= blockRow && (int)(nextVertTouchY / TILE_SIZE) < blockRowEnd) {
+                nextVertTouchX += vertStepX;
+                nextVertTouchY += vertStepY;
+                vertColumn += vertColumnStep;
+            }
+            while (horzRow >= blockRow && horzRow < blockRowEnd && nextHorzTouchX >= 0 &&
+                   (int)(nextHorzTouchX / TILE_SIZE) >= blockColumn && (int)(nextHorzTouchX / TILE_SIZE) < blockColumnEnd) {
+                nextHorzTouchX += horzStepX;
+                nextHorzTouchY += horzStepY;
+                horzRow += horzRowStep;
+            }
+            continue;
+        }
+        PROFILE_COUNT(wallChecks, 1);
+        wallHitContent = *mapCellAt(column, row);
+#else
+        PROFILE_COUNT(wallChecks, 1);
+        wallHitContent = mapContentAt(column, row);
+#endif
+        if (wallHitContent == MAP_THIN_WALL) {
+            isThinWallHit = hitThinWall(column, row, rayDir, &wallHitX, &wallHitY, &wallHitContent, &wasHitVertical);
+            wallHitContent = isThinWallHit ? wallHitContent : 0;
+        }
+        if (wallHitContent != 0)
+            break;
+    }
+
+    if (wallHitContent != 0 && !isThinWallHit) {
+        // A ray passing (almost) exactly through a grid corner touches both lines at (almost) the same point.
+        // castRay() settles these ties by comparing squared distances, so the pending touch on the other axis
+        // wins if it has a wall behind it too and is closer by that measure:
+        const float hitDistance = squaredDistanceBetweenPoints(view->position.x, view->position.y, wallHitX, wallHitY);
+        if (wasHitVertical) {
+            const int column = (int)(nextHorzTouchX / TILE_SIZE);
+            if (horzRow >= 0 && horzRow < map.numRows && nextHorzTouchX >= 0 && column < map.numCols &&
+                mapContentAt(column, horzRow) != 0 && mapContentAt(column, horzRow) != MAP_THIN_WALL &&
+                squaredDistanceBetweenPoints(view->position.x, view->position.y, nextHorzTouchX, nextHorzTouchY) <= hitDistance) {
+                wasHitVertical = FALSE;
+                wallHitX = nextHorzTouchX;
+                wallHitY = nextHorzTouchY;
+                wallHitContent = mapContentAt(column, horzRow);
+            }
+        } else {
+            const int row = (int)(nextVertTouchY / TILE_SIZE);
+            if (vertColumn >= 0 && vertColumn < map.numCols && nextVertTouchY >= 0 && row < map.numRows &&
+                mapContentAt(vertColumn, row) != 0 && mapContentAt(vertColumn, row) != MAP_THIN_WALL &&
+                squaredDistanceBetweenPoints(view->position.x, view->position.y, nextVertTouchX, nextVertTouchY) < hitDistance) {
+                wasHitVertical = TRUE;
+                wallHitX = nextVertTouchX;
+                wallHitY = nextVertTouchY;
+                wallHitContent = mapContentAt(vertColumn, row);
+            }
+        }
+    }
+
+    view->rays[stripId].wallHit.x = wallHitX;
+    view->rays[stripId].wallHit.y = wallHitY;
+    view->rays[stripId].wallHitContent = wallHitContent;
+    view->rays[stripId].wasHitVertical = wasHitVertical;
+    view->rays[stripId].direction.x = rayDir->x;
+    view->rays[stripId].direction.y = rayDir->y;
+}
+// =========
@@ -0,0 +1,30 @@
+// Depth-only output:
+// =========
+// For uses that only look at what each column sees (agents' perception, collision probes...), a view can
+// project into depth columns instead of pixels: per column, the perpendicular distance to the wall (the same
+// depth the projection sizes walls by, in map units), the content of the wall, and whether it was hit on a
+// vertical grid line. Each is an array of its own, so a consumer reads only what it needs, contiguously.
+// Rays are cast exactly as for pixels, but walls, floors and ceilings are never filled, and nothing is
+// uploaded to the window.
+struct DepthColumns {
+    float depths[NUM_RAYS];
+    MapCell wallContents[NUM_RAYS];
+    uint8_t wasHitVertical[NUM_RAYS];
+};
+
+// The player's, when projecting depths instead of colorBuffer (see playerView.depthColumns):
+struct DepthColumns playerDepthColumns;
+
+void projectDepthTile(int tile) {
+    const int firstStrip = tile * COLUMN_TILE_WIDTH;
+    const int lastStrip = firstStrip + COLUMN_TILE_WIDTH < NUM_RAYS ? firstStrip + COLUMN_TILE_WIDTH : NUM_RAYS;
+    struct DepthColumns* columns = view->depthColumns;
+    for (int i = firstStrip; i < lastStrip; i++) {
+        vec2 direction;
+        setDirection(&direction, &view->position, &view->rays[i].wallHit);
+        columns->depths[i] = dot(&direction, &view->orientation);
+        columns->wallContents[i] = (MapCell)view->rays[i].wallHitContent;
+        columns->wasHitVertical[i] = (uint8_t)view->rays[i].wasHitVertical;
+    }
+}
+// =========
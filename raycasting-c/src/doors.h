@@ -0,0 +1,248 @@
+// Thin walls and doors:
+// =========
+// A thin wall stands inside a cell instead of filling it: it lies along one of the cell's axes, inset into the
+// cell by a fraction of a tile (half of it for a door), and can slide open along itself, from the start of the
+// cell (its top or left end) by an open fraction, from 0 (closed) to 1 (fully open).
+// Its cell holds MAP_THIN_WALL, so every lookup that only asks whether a cell is empty still treats it as a
+// wall, and the rest of the thin wall is kept in thinWalls, sorted by cell. Traversal finds the cell as it
+// would a wall, then only hits the thin wall if the ray crosses its line inside the cell and past the part that
+// slid open (see hitThinWall()), and carries on through the cell otherwise. The float kernels (castRay() and
+// castRayDDA()) do this themselves, and the rays the fixed-point and packet kernels end on a thin wall cell are
+// cast again with them (see recastThinWallHits()).
+// The view's own cell is never stepped onto, so a thin wall in it is checked before casting (see
+// castViewCellThinWall()), and the player is only kept from crossing a thin wall's line, rather than from
+// entering its cell (see isThinWallInTheWay()).
+// Doors open and close over the simulation's ticks (see moveThinWalls()), and every step of a door is a map
+// edit of its cell, so only what sees that cell is updated (see map.h).
+#define MAP_THIN_WALL 255 // the content of a cell holding a thin wall (thin walls have their own content)
+#define DOOR_INSET 0.5f
+#define DOOR_OPEN_SPEED 0.5f // of the door, per second
+
+struct ThinWall {
+    size_t cell; // row * map.numCols + column
+    int content;
+    int isVertical;     // whether it lies along the cell's vertical axis (so it's hit like a vertical grid line)
+    float inset;        // from the cell's left or top side, as a fraction of a tile
+    float openFraction;
+    float openSpeed;    // per second, while opening (> 0) or closing (< 0)
+    int isCycling;      // whether it keeps opening and closing, rather than stopping when fully open or closed
+};
+
+struct ThinWalls {
+    struct ThinWall* walls; // sorted by cell
+    int count;
+    int capacity;
+    int moving; // how many are opening or closing
+} thinWalls;
+
+struct ThinWall* findThinWall(int column, int row) {
+    const size_t cell = (size_t)row * map.numCols + column;
+    int first = 0, last = thinWalls.count;
+    while (first < last) {
+        const int middle = (first + last) / 2;
+        if (thinWalls.walls[middle].cell < cell)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    return first < thinWalls.count && thinWalls.walls[first].cell == cell ? &thinWalls.walls[first] : NULL;
+}
+
+int addThinWall(int column, int row, int content, int isVertical, float inset) {
+    // Into an empty cell:
+    if (column < 0 || column >= map.numCols || row < 0 || row >= map.numRows || mapContentAt(column, row) != 0 ||
+        content <= 0 || content >= MAP_THIN_WALL) {
+        fprintf(stderr, "Error: can't add a thin wall at (%d, %d).\n", column, row);
+        return FALSE;
+    }
+    if (thinWalls.count == thinWalls.capacity) {
+        const int capacity = thinWalls.capacity ? thinWalls.capacity * 2 : 16;
+        struct ThinWall* walls = (struct ThinWall*) realloc(thinWalls.walls, sizeof(struct ThinWall) * capacity);
+        if (!walls) {
+            fprintf(stderr, "Error allocating thin walls.\n");
+            return FALSE;
+        }
+        thinWalls.walls = walls;
+        thinWalls.capacity = capacity;
+    }
+
+    const size_t cell = (size_t)row * map.numCols + column;
+    int i = thinWalls.count;
+    while (i > 0 && thinWalls.walls[i - 1].cell > cell) {
+        thinWalls.walls[i] = thinWalls.walls[i - 1];
+        i--;
+    }
+    struct ThinWall* wall = &thinWalls.walls[i];
+    memset(wall, 0, sizeof(*wall));
+    wall->cell = cell;
+    wall->content = content;
+    wall->isVertical = isVertical;
+    wall->inset = inset;
+    thinWalls.count++;
+    setMapCell(column, row, MAP_THIN_WALL);
+    return TRUE;
+}
+
+void removeThinWall(int column, int row) {
+    struct ThinWall* wall = findThinWall(column, row);
+    if (!wall)
+        return;
+    const int i = (int)(wall - thinWalls.walls);
+    thinWalls.moving -= wall->openSpeed != 0;
+    memmove(wall, wall + 1, sizeof(struct ThinWall) * (thinWalls.count - i - 1));
+    thinWalls.count--;
+    setMapCell(column, row, 0);
+}
+
+void freeThinWalls() {
+    free(thinWalls.walls);
+    memset(&thinWalls, 0, sizeof(thinWalls));
+}
+
+void markThinWallEdited(const struct ThinWall* wall) {
+    const int column = (int)(wall->cell % (size_t)map.numCols);
+    const int row = (int)(wall->cell / (size_t)map.numCols);
+    markMapEdited(column, row, column, row);
+}
+
+void setThinWallOpening(struct ThinWall* wall, float openSpeed, int isCycling) {
+    // Starts opening (or closing, with a negative speed) on the next ticks, or stops it with 0:
+    thinWalls.moving += (openSpeed != 0) - (wall->openSpeed != 0);
+    wall->openSpeed = openSpeed;
+    wall->isCycling = isCycling;
+}
+
+void moveThinWalls(float deltaTime) {
+    // A tick of the doors that are opening or closing:
+    for (int i = 0; i < thinWalls.count && thinWalls.moving > 0; i++) {
+        struct ThinWall* wall = &thinWalls.walls[i];
+        if (wall->openSpeed == 0)
+            continue;
+        float openFraction = wall->openFraction + wall->openSpeed * deltaTime;
+        if (openFraction <= 0 || openFraction >= 1) {
+            openFraction = openFraction <= 0 ? 0 : 1;
+            setThinWallOpening(wall, wall->isCycling ? -wall->openSpeed : 0, wall->isCycling);
+        }
+        wall->openFraction = openFraction;
+        markThinWallEdited(wall);
+    }
+}
+
+int hitThinWall(int column, int row, vec2* rayDir, float* wallHitX, float* wallHitY, int* content, int* wasHitVertical) {
+    // Whether a ray entering a thin wall's cell hits it, and where. It has to cross the wall's line ahead of the
+    // view, inside the cell, and past the part that slid open:
+    const struct ThinWall* wall = findThinWall(column, row);
+    if (!wall)
+        return FALSE;
+    float x, y, along;
+    if (wall->isVertical) {
+        x = (column + wall->inset) * TILE_SIZE;
+        if ((x - view->position.x) * rayDir->x <= 0)
+            return FALSE;
+        y = view->position.y + (x - view->position.x) * rayDir->y / rayDir->x;
+        along = y - (float)row * TILE_SIZE;
+    } else {
+        y = (row + wall->inset) * TILE_SIZE;
+        if ((y - view->position.y) * rayDir->y <= 0)
+            return FALSE;
+        x = view->position.x + (y - view->position.y) * rayDir->x / rayDir->y;
+        along = x - (float)column * TILE_SIZE;
+    }
+    if (along < wall->openFraction * TILE_SIZE || along >= TILE_SIZE)
+        return FALSE;
+
+    *wallHitX = x;
+    *wallHitY = y;
+    *content = wall->content;
+    *wasHitVertical = wall->isVertical;
+    return TRUE;
+}
+
+int castViewCellThinWall(vec2* rayDir, int stripId) {
+    // The kernels step from one grid line to the next, so a thin wall in the view's own cell is never stepped
+    // onto. When the ray hits it, nothing else is nearer, so it's the ray's hit:
+    const struct ThinWall* wall = NULL;
+    if (thinWalls.count == 0 || view->position.x < 0 || view->position.x >= map.width ||
+        view->position.y < 0 || view->position.y >= map.height ||
+        !(wall = findThinWall((int)(view->position.x / TILE_SIZE), (int)(view->position.y / TILE_SIZE))))
+        return FALSE;
+    const int column = (int)(wall->cell % (size_t)map.numCols);
+    const int row = (int)(wall->cell / (size_t)map.numCols);
+    struct Ray* ray = &view->rays[stripId];
+    int content, wasHitVertical;
+    if (!hitThinWall(column, row, rayDir, &ray->wallHit.x, &ray->wallHit.y, &content, &wasHitVertical))
+        return FALSE;
+    ray->wallHitContent = content;
+    ray->wasHitVertical = wasHitVertical;
+    ray->direction = *rayDir;
+    return TRUE;
+}
+
+int isThinWallCrossed(const struct ThinWall* wall, float fromX, float fromY, float toX, float toY) {
+    // Whether a move crosses the wall's line inside its cell, past the part that slid open:
+    const int column = (int)(wall->cell % (size_t)map.numCols);
+    const int row = (int)(wall->cell / (size_t)map.numCols);
+    const float line = ((wall->isVertical ? column : row) + wall->inset) * TILE_SIZE;
+    const float from = wall->isVertical ? fromX : fromY;
+    const float to = wall->isVertical ? toX : toY;
+    if ((from < line) == (to < line))
+        return FALSE;
+    const float fromAlong = wall->isVertical ? fromY : fromX;
+    const float toAlong = wall->isVertical ? toY : toX;
+    const float along = fromAlong + (line - from) * (toAlong - fromAlong) / (to - from) -
+        (float)(wall->isVertical ? row : column) * TILE_SIZE;
+    return along >= wall->openFraction * TILE_SIZE && along < TILE_SIZE;
+}
+
+int isThinWallInTheWay(float fromX, float fromY, float toX, float toY) {
+    // Whether a move between two points of the map (shorter than a tile) crosses the closed part of the thin
+    // wall in the cell of either end. Only the wall's line is in the way, so the player can stand in a door's
+    // cell while the door closes, and walk out of it on their own side:
+    if (thinWalls.count == 0)
+        return FALSE;
+    const struct ThinWall* fromWall = findThinWall((int)(fromX / TILE_SIZE), (int)(fromY / TILE_SIZE));
+    const struct ThinWall* toWall = findThinWall((int)(toX / TILE_SIZE), (int)(toY / TILE_SIZE));
+    return (fromWall && isThinWallCrossed(fromWall, fromX, fromY, toX, toY)) ||
+        (toWall && toWall != fromWall && isThinWallCrossed(toWall, fromX, fromY, toX, toY));
+}
+
+int isThinWallAt(float x, float y) {
+    // Whether a point of the map is in a thin wall's cell:
+    return thinWalls.count > 0 && x >= 0 && x < map.width && y >= 0 && y < map.height &&
+        findThinWall((int)(x / TILE_SIZE), (int)(y / TILE_SIZE));
+}
+
+int isThinWallOpenAt(float x, float y) {
+    // Whether the thin wall at a point of the map (if any) is fully open, so an agent can pass:
+    if (thinWalls.count == 0 || x < 0 || x >= map.width || y < 0 || y >= map.height)
+        return FALSE;
+    const struct ThinWall* wall = findThinWall((int)(x / TILE_SIZE), (int)(y / TILE_SIZE));
+    return wall && wall->openFraction >= 1;
+}
+
+int scatterDoors(int count, unsigned int seed) {
+    // Puts cycling doors into empty cells at random, across the corridor when the cell is between two walls
+    // (and in either direction otherwise), each starting at its own point of the cycle:
+    unsigned int random = seed ? seed : 1;
+    const int maxAttempts = count * 100;
+    for (int attempts = 0; count > 0 && attempts < maxAttempts; attempts++) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        const int column = 1 + (int)(random % (unsigned int)(map.numCols > 2 ? map.numCols - 2 : 1));
+        const int row = 1 + (int)((random / (unsigned int)map.numCols) % (unsigned int)(map.numRows > 2 ? map.numRows - 2 : 1));
+        if (column >= map.numCols - 1 || row >= map.numRows - 1 || mapContentAt(column, row) != 0)
+            continue;
+        const int isBetweenColumns = mapContentAt(column - 1, row) != 0 && mapContentAt(column + 1, row) != 0;
+        const int isBetweenRows = mapContentAt(column, row - 1) != 0 && mapContentAt(column, row + 1) != 0;
+        const int isVertical = isBetweenRows || (!isBetweenColumns && (random >> 24) & 1);
+        if (!addThinWall(column, row, 1 + (int)((random >> 8) % NUM_TEXTURES), isVertical, DOOR_INSET))
+            return FALSE;
+        struct ThinWall* door = findThinWall(column, row);
+        door->openFraction = (float)((random >> 16) & 255) / 255;
+        setThinWallOpening(door, (random >> 25) & 1 ? DOOR_OPEN_SPEED : -DOOR_OPEN_SPEED, TRUE);
+        count--;
+    }
+    return TRUE;
+}
+// =========
@@ -0,0 +1,174 @@
+// Floor and ceiling casting:
+// =========
+// The floor seen on a given row below the horizon is always at the same depth (distance along the player's
+// orientation), and the ceiling on the mirrored row above the horizon is at the same depth too, so both
+// share one world position per pixel, and one table of depths per row computed once at startup.
+// Scaled to unit depth, the ray of a column is (orientation + tangent * perpendicular), with the tangent
+// coming from the column's rational rotation amount (see column_tangents), so the floor point of a pixel is
+// the player's position plus its row's depth times its column's unit depth ray: a multiply-add per axis,
+// without any divides or trig. Rays are spread by equal rotation amounts, which are not equally spaced on
+// the projection plane, so the unit depth rays are looked up per column rather than stepped linearly.
+// The depths of a column's rows are contiguous, so the rows of a column are cast 4 (SSE2) or 8 (AVX2)
+// at a time. (Texture sizes must be powers of 2)
+// With shading (see lighting.h), each row's light level comes with its depth, from a table of its own, and
+// the rows are cast one at a time.
+#define FLOOR_TEXTURE 1
+#define CEILING_TEXTURE (NUM_TEXTURES + 2) // the darker copy
+
+typedef void (*FloorKernel)(Uint32* column, int stride, int firstRow, float unitDepthX, float unitDepthY);
+
+float floor_row_depths[WINDOW_HEIGHT / 2];
+uint8_t floor_row_lights[WINDOW_HEIGHT / 2];
+
+void setFloorRowDepths() {
+    // Where the projection puts the bottom of a wall at a given depth, solved for the depth
+    // (at the center of each pixel):
+    const float distanceProjPlane = (WINDOW_WIDTH / 2) * (FOCAL_LENGTH / 2);
+    for (int row = 0; row < WINDOW_HEIGHT / 2; row++) {
+        floor_row_depths[row] = ((TILE_SIZE / 2) * distanceProjPlane) / (row + 0.5f);
+        floor_row_lights[row] = (uint8_t)lightLevelAt(floor_row_depths[row]);
+    }
+}
+
+void castFloorColumnScalar(Uint32* column, int stride, int firstRow, float unitDepthX, float unitDepthY) {
+    // Fills the floor from firstRow down to the bottom of the screen, and the ceiling from the mirrored row up
+    // (positions are scaled to texels up front, the same way the SIMD kernels do it, so they all round alike):
+    const Uint32* floorTexels = &wallTextures[FLOOR_TEXTURE * TEXTURE_SIZE];
+    const Uint32* ceilingTexels = &wallTextures[CEILING_TEXTURE * TEXTURE_SIZE];
+    const float dx = unitDepthX * ((float)TEXTURE_WIDTH / TILE_SIZE);
+    const float dy = unitDepthY * ((float)TEXTURE_HEIGHT / TILE_SIZE);
+    const float originX = view->position.x * ((float)TEXTURE_WIDTH / TILE_SIZE);
+    const float originY = view->position.y * ((float)TEXTURE_HEIGHT / TILE_SIZE);
+    for (int y = firstRow; y < WINDOW_HEIGHT; y++) {
+        const float depth = floor_row_depths[y - (WINDOW_HEIGHT / 2)];
+        const int textureX = (int)(originX + depth * dx) & (TEXTURE_WIDTH - 1);
+        const int textureY = (int)(originY + depth * dy) & (TEXTURE_HEIGHT - 1);
+        const int texel = (textureX * TEXTURE_HEIGHT) + textureY;
+        column[stride * y] = floorTexels[texel];
+        column[stride * (WINDOW_HEIGHT - 1 - y)] = ceilingTexels[texel];
+    }
+}
+
+void castFloorColumnColormap(Uint32* column, int stride, int firstRow, float unitDepthX, float unitDepthY) {
+    // As castFloorColumnScalar(), looking the palette indices of the texels up in the colormaps of the rows:
+    const uint8_t* floorIndices = &wallTextureIndices[FLOOR_TEXTURE * TEXTURE_SIZE];
+    const uint8_t* ceilingIndices = &wallTextureIndices[CEILING_TEXTURE * TEXTURE_SIZE];
+    const float dx = unitDepthX * ((float)TEXTURE_WIDTH / TILE_SIZE);
+    const float dy = unitDepthY * ((float)TEXTURE_HEIGHT / TILE_SIZE);
+    const float originX = view->position.x * ((float)TEXTURE_WIDTH / TILE_SIZE);
+    const float originY = view->position.y * ((float)TEXTURE_HEIGHT / TILE_SIZE);
+    for (int y = firstRow; y < WINDOW_HEIGHT; y++) {
+        const float depth = floor_row_depths[y - (WINDOW_HEIGHT / 2)];
+        const Uint32* colormap = colormaps[floor_row_lights[y - (WINDOW_HEIGHT / 2)]];
+        const int textureX = (int)(originX + depth * dx) & (TEXTURE_WIDTH - 1);
+        const int textureY = (int)(originY + depth * dy) & (TEXTURE_HEIGHT - 1);
+        const int texel = (textureX * TEXTURE_HEIGHT) + textureY;
+        column[stride * y] = colormap[floorIndices[texel]];
+        column[stride * (WINDOW_HEIGHT - 1 - y)] = colormap[ceilingIndices[texel]];
+    }
+}
+
+void castFloorColumnNaive(Uint32* column, int stride, int firstRow, float unitDepthX, float unitDepthY) {
+    // As castFloorColumnScalar(), scaling the channels of every texel by the light of its row:
+    const Uint32* floorTexels = &wallTextures[FLOOR_TEXTURE * TEXTURE_SIZE];
+    const Uint32* ceilingTexels = &wallTextures[CEILING_TEXTURE * TEXTURE_SIZE];
+    const float dx = unitDepthX * ((float)TEXTURE_WIDTH / TILE_SIZE);
+    const float dy = unitDepthY * ((float)TEXTURE_HEIGHT / TILE_SIZE);
+    const float originX = view->position.x * ((float)TEXTURE_WIDTH / TILE_SIZE);
+    const float originY = view->position.y * ((float)TEXTURE_HEIGHT / TILE_SIZE);
+    for (int y = firstRow; y < WINDOW_HEIGHT; y++) {
+        const float depth = floor_row_depths[y - (WINDOW_HEIGHT / 2)];
+        const int level = floor_row_lights[y - (WINDOW_HEIGHT / 2)];
+        const int textureX = (int)(originX + depth * dx) & (TEXTURE_WIDTH - 1);
+        const int textureY = (int)(originY + depth * dy) & (TEXTURE_HEIGHT - 1);
+        const int texel = (textureX * TEXTURE_HEIGHT) + textureY;
+        column[stride * y] = shadeColor(floorTexels[texel], level);
+        column[stride * (WINDOW_HEIGHT - 1 - y)] = shadeColor(ceilingTexels[texel], level);
+    }
+}
+
+FloorKernel castFloorColumn = castFloorColumnScalar;
+
+#ifdef PACKET_SIMD
+__attribute__((target("sse2")))
+void castFloorColumnSSE2(Uint32* column, int stride, int firstRow, float unitDepthX, float unitDepthY) {
+    const Uint32* floorTexels = &wallTextures[FLOOR_TEXTURE * TEXTURE_SIZE];
+    const Uint32* ceilingTexels = &wallTextures[CEILING_TEXTURE * TEXTURE_SIZE];
+    const __m128 dx = _mm_set1_ps(unitDepthX * ((float)TEXTURE_WIDTH / TILE_SIZE));
+    const __m128 dy = _mm_set1_ps(unitDepthY * ((float)TEXTURE_HEIGHT / TILE_SIZE));
+    const __m128 originX = _mm_set1_ps(view->position.x * ((float)TEXTURE_WIDTH / TILE_SIZE));
+    const __m128 originY = _mm_set1_ps(view->position.y * ((float)TEXTURE_HEIGHT / TILE_SIZE));
+    const __m128i maskX = _mm_set1_epi32(TEXTURE_WIDTH - 1);
+    const __m128i maskY = _mm_set1_epi32(TEXTURE_HEIGHT - 1);
+
+    int texels[4];
+    int y = firstRow;
+    for (; y + 4 <= WINDOW_HEIGHT; y += 4) {
+        const __m128 depth = _mm_loadu_ps(&floor_row_depths[y - (WINDOW_HEIGHT / 2)]);
+        const __m128i textureX = _mm_and_si128(_mm_cvttps_epi32(_mm_add_ps(originX, _mm_mul_ps(depth, dx))), maskX);
+        const __m128i textureY = _mm_and_si128(_mm_cvttps_epi32(_mm_add_ps(originY, _mm_mul_ps(depth, dy))), maskY);
+        _mm_storeu_si128((__m128i*)texels, _mm_or_si128(_mm_slli_epi32(textureX, __builtin_ctz(TEXTURE_HEIGHT)), textureY));
+        for (int i = 0; i < 4; i++) {
+            column[stride * (y + i)] = floorTexels[texels[i]];
+            column[stride * (WINDOW_HEIGHT - 1 - y - i)] = ceilingTexels[texels[i]];
+        }
+    }
+    if (y < WINDOW_HEIGHT)
+        castFloorColumnScalar(column, stride, y, unitDepthX, unitDepthY);
+}
+
+__attribute__((target("avx2")))
+void castFloorColumnAVX2(Uint32* column, int stride, int firstRow, float unitDepthX, float unitDepthY) {
+    const Uint32* floorTexels = &wallTextures[FLOOR_TEXTURE * TEXTURE_SIZE];
+    const Uint32* ceilingTexels = &wallTextures[CEILING_TEXTURE * TEXTURE_SIZE];
+    const __m256 dx = _mm256_set1_ps(unitDepthX * ((float)TEXTURE_WIDTH / TILE_SIZE));
+    const __m256 dy = _mm256_set1_ps(unitDepthY * ((float)TEXTURE_HEIGHT / TILE_SIZE));
+    const __m256 originX = _mm256_set1_ps(view->position.x * ((float)TEXTURE_WIDTH / TILE_SIZE));
+    const __m256 originY = _mm256_set1_ps(view->position.y * ((float)TEXTURE_HEIGHT / TILE_SIZE));
+    const __m256i maskX = _mm256_set1_epi32(TEXTURE_WIDTH - 1);
+    const __m256i maskY = _mm256_set1_epi32(TEXTURE_HEIGHT - 1);
+    const __m256i reversed = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+    int y = firstRow;
+    for (; y + 8 <= WINDOW_HEIGHT; y += 8) {
+        const __m256 depth = _mm256_loadu_ps(&floor_row_depths[y - (WINDOW_HEIGHT / 2)]);
+        const __m256i textureX = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_add_ps(originX, _mm256_mul_ps(depth, dx))), maskX);
+        const __m256i textureY = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_add_ps(originY, _mm256_mul_ps(depth, dy))), maskY);
+        const __m256i texels = _mm256_or_si256(_mm256_slli_epi32(textureX, __builtin_ctz(TEXTURE_HEIGHT)), textureY);
+        const __m256i floorColors = _mm256_i32gather_epi32((const int*)floorTexels, texels, 4);
+        const __m256i ceilingColors = _mm256_i32gather_epi32((const int*)ceilingTexels, texels, 4);
+        if (stride == 1) {
+            // The ceiling goes up the column, so its 8 pixels are stored in reverse:
+            _mm256_storeu_si256((__m256i*)&column[y], floorColors);
+            _mm256_storeu_si256((__m256i*)&column[WINDOW_HEIGHT - 8 - y], _mm256_permutevar8x32_epi32(ceilingColors, reversed));
+        } else {
+            Uint32 colors[16];
+            _mm256_storeu_si256((__m256i*)colors, floorColors);
+            _mm256_storeu_si256((__m256i*)&colors[8], ceilingColors);
+            for (int i = 0; i < 8; i++) {
+                column[stride * (y + i)] = colors[i];
+                column[stride * (WINDOW_HEIGHT - 1 - y - i)] = colors[8 + i];
+            }
+        }
+    }
+    if (y < WINDOW_HEIGHT)
+        castFloorColumnScalar(column, stride, y, unitDepthX, unitDepthY);
+}
+#endif
+
+void selectFloorKernel() {
+    // Picks the widest floor kernel the CPU supports (or the shading's own):
+    castFloorColumn = castFloorColumnScalar;
+    if (lighting.shading != SHADING_NONE) {
+        castFloorColumn = lighting.shading == SHADING_COLORMAP ? castFloorColumnColormap : castFloorColumnNaive;
+        return;
+    }
+#ifdef PACKET_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        castFloorColumn = castFloorColumnAVX2;
+    else if (__builtin_cpu_supports("sse2"))
+        castFloorColumn = castFloorColumnSSE2;
+#endif
+}
+// =========
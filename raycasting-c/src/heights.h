@@ -0,0 +1,322 @@
+// Wall heights:
+// =========
+// Walls can be lower than the ceiling (see mapHeightAt()), with the floor at 0, the eye at half the full
+// height, and the ceiling at MAP_FULL_HEIGHT, so walls reaching it are as tall as anything gets. Over a low
+// wall, a ray sees the walls behind it, so instead of stopping at its first wall, castLowWallRay() carries on
+// through the grid, recording each wall it sees in the ray's hits (nearest first).
+// Each column keeps the span of rows still open as it goes: a wall covers the rows from its top down, since
+// anything further away is projected closer to the horizon, and the ceiling in front of a wall covers the rows
+// above a full height wall there. So walls (and their tops, seen from above when they're below the eye) only
+// ever shrink the span, and the ray stops as soon as nothing is left open. A wall of full height closes the
+// span on its own, so walking on past the first hit only costs anything over low walls.
+// Only the rays whose first hit is a low wall are cast again like this, after whichever kernel cast them (as
+// thin walls are, see recastThinWallHits()), so maps without low walls never get here at all. Thin walls are
+// always of full height.
+// The z-buffer and depth columns keep the nearest wall, so sprites behind a low wall are hidden behind it.
+
+struct WallRows {
+    int fullTop; // where a wall of full height would start (and the ceiling in front of the wall ends)
+    int top;
+    int capTop;  // where the top of a wall below the eye starts, seen from above (or top, for other walls)
+    int bottom;
+    int stripHeight; // of a wall of full height
+};
+
+struct WallSpans {
+    int wallFirst; // the rows of the wall and of its top left visible, from first up to (not including) last
+    int wallLast;
+    int capFirst;
+    int capLast;
+};
+
+struct OpenRows {
+    int top; // the rows nothing covers yet, from top up to (not including) bottom
+    int bottom;
+    int floorStart; // the first row of floor seen in front of any wall
+    int ceilingEnd; // one past the last row of ceiling seen in front of any wall
+};
+
+void setWallRows(struct WallRows* rows, float depth, float exitDepth, int height) {
+    // Where a wall of a given height is projected, as projectColumn() projects walls of full height:
+    const float distanceProjPlane = (WINDOW_WIDTH / 2) * (FOCAL_LENGTH / 2);
+    rows->stripHeight = (int)((TILE_SIZE / depth) * distanceProjPlane);
+    rows->fullTop = (WINDOW_HEIGHT / 2) - (rows->stripHeight / 2);
+    rows->bottom = (WINDOW_HEIGHT / 2) + (rows->stripHeight / 2);
+    rows->top = rows->fullTop + (int)(((MAP_FULL_HEIGHT - height) / depth) * distanceProjPlane);
+    rows->capTop = rows->top;
+    if (2 * height < MAP_FULL_HEIGHT) {
+        // The far edge of the top, where the ray leaves the wall's cell:
+        const int exitStripHeight = (int)((TILE_SIZE / exitDepth) * distanceProjPlane);
+        rows->capTop = (WINDOW_HEIGHT / 2) - (exitStripHeight / 2) + (int)(((MAP_FULL_HEIGHT - height) / exitDepth) * distanceProjPlane);
+    }
+}
+
+void openAllRows(struct OpenRows* open) {
+    open->top = 0;
+    open->bottom = WINDOW_HEIGHT;
+    open->floorStart = WINDOW_HEIGHT;
+    open->ceilingEnd = 0;
+}
+
+void occludeRows(struct OpenRows* open, const struct WallRows* rows, struct WallSpans* spans) {
+    // Clips the next wall (going away from the view) to the open rows, and covers the rows it takes. The floor in
+    // front of the wall shows below it, and the ceiling in front of it above where a full height wall would end:
+    if (rows->bottom < open->bottom && open->top < open->bottom) {
+        const int floorStart = rows->bottom > open->top ? rows->bottom : open->top;
+        open->floorStart = floorStart < open->floorStart ? floorStart : open->floorStart;
+    }
+    if (rows->fullTop > open->top && open->top < open->bottom) {
+        const int ceilingEnd = rows->fullTop < open->bottom ? rows->fullTop : open->bottom;
+        open->ceilingEnd = ceilingEnd > open->ceilingEnd ? ceilingEnd : open->ceilingEnd;
+    }
+    spans->wallFirst = rows->top > open->top ? rows->top : open->top;
+    spans->wallLast = rows->bottom < open->bottom ? rows->bottom : open->bottom;
+    spans->capFirst = rows->capTop > open->top ? rows->capTop : open->top;
+    spans->capLast = rows->top < open->bottom ? rows->top : open->bottom;
+    open->bottom = rows->capTop < open->bottom ? rows->capTop : open->bottom;
+    open->top = rows->fullTop > open->top ? rows->fullTop : open->top;
+}
+
+void closeOpenRows(struct OpenRows* open) {
+    // Whatever is still open past the last wall is floor below the horizon, and ceiling above it:
+    if (open->top >= open->bottom)
+        return;
+    const int floorStart = open->top > (WINDOW_HEIGHT / 2) ? open->top : (WINDOW_HEIGHT / 2);
+    const int ceilingEnd = open->bottom < (WINDOW_HEIGHT / 2) ? open->bottom : (WINDOW_HEIGHT / 2);
+    open->floorStart = floorStart < open->floorStart ? floorStart : open->floorStart;
+    open->ceilingEnd = ceilingEnd > open->ceilingEnd ? ceilingEnd : open->ceilingEnd;
+}
+
+int isLowWallHit(const struct Ray* ray) {
+    // Whether the ray's first hit could be a low wall. The cell behind the hit is found as the kernels find it, so
+    // a thin wall's hit inside its cell can be taken for its neighbour's, which only casts it again for nothing:
+    if (ray->wallHitContent == 0)
+        return FALSE;
+    int column = (int)(ray->wallHit.x / TILE_SIZE);
+    int row = (int)(ray->wallHit.y / TILE_SIZE);
+    if (ray->wasHitVertical)
+        column -= ray->direction.x < 0 ? 1 : 0;
+    else
+        row -= ray->direction.y < 0 ? 1 : 0;
+    return column >= 0 && column < map.numCols && row >= 0 && row < map.numRows &&
+        mapContentAt(column, row) != MAP_THIN_WALL && mapHeightAt(column, row) < MAP_FULL_HEIGHT;
+}
+
+void castLowWallRay(vec2* rayDir, int stripId) {
+    // Walks the grid like castRayDDA(), through every wall that leaves some of the column open:
+    PROFILE_COUNT(rays, 1);
+    struct RayHits* hits = &view->rayHits[stripId];
+    const int isRayFacingDown = rayDir->y > 0;
+    const int isRayFacingRight = rayDir->x > 0;
+
+    // A ray along one of the axes never touches the grid lines parallel to it, so their next touch is FLT_MAX
+    // away, the way castRay() counts a missing hit (rather than dividing by zero):
+    int horzRow = (int)floor(view->position.y / TILE_SIZE) + (isRayFacingDown ? 1 : -1);
+    float nextHorzTouchY = FLT_MAX;
+    float nextHorzTouchX = FLT_MAX;
+    float horzStepX = 0;
+    if (rayDir->y != 0) {
+        nextHorzTouchY = (float)floor(view->position.y / TILE_SIZE) * TILE_SIZE + (isRayFacingDown ? TILE_SIZE : 0);
+        nextHorzTouchX = view->position.x + (nextHorzTouchY - view->position.y) * rayDir->x / rayDir->y;
+        horzStepX = TILE_SIZE * rayDir->x / rayDir->y;
+    }
+    horzStepX *= (!isRayFacingRight && horzStepX > 0) ? -1 : 1;
+    horzStepX *= (isRayFacingRight && horzStepX < 0) ? -1 : 1;
+    const float horzStepY = isRayFacingDown ? TILE_SIZE : -TILE_SIZE;
+    const int horzRowStep = isRayFacingDown ? 1 : -1;
+
+    int vertColumn = (int)floor(view->position.x / TILE_SIZE) + (isRayFacingRight ? 1 : -1);
+    float nextVertTouchX = FLT_MAX;
+    float nextVertTouchY = FLT_MAX;
+    float vertStepY = 0;
+    if (rayDir->x != 0) {
+        nextVertTouchX = (float)floor(view->position.x / TILE_SIZE) * TILE_SIZE + (isRayFacingRight ? TILE_SIZE : 0);
+        nextVertTouchY = view->position.y + (nextVertTouchX - view->position.x) * rayDir->y / rayDir->x;
+        vertStepY = TILE_SIZE * rayDir->y / rayDir->x;
+    }
+    vertStepY *= (!isRayFacingDown && vertStepY > 0) ? -1 : 1;
+    vertStepY *= (isRayFacingDown && vertStepY < 0) ? -1 : 1;
+    const float vertStepX = isRayFacingRight ? TILE_SIZE : -TILE_SIZE;
+    const int vertColumnStep = isRayFacingRight ? 1 : -1;
+
+    const float rayDirX = fabsf(rayDir->x);
+    const float rayDirY = fabsf(rayDir->y);
+
+    struct OpenRows open;
+    openAllRows(&open);
+    hits->count = 0;
+    hits->end = view->position;
+    while (open.top < open.bottom && hits->count < MAX_RAY_HITS) {
+        int row, column, wasHitVertical;
+        float wallHitX, wallHitY;
+        if (fabsf(nextVertTouchX - view->position.x) * rayDirY < fabsf(nextHorzTouchY - view->position.y) * rayDirX) {
+            row = (int)(nextVertTouchY / TILE_SIZE);
+            column = vertColumn;
+            PROFILE_COUNT(verticalSteps, 1);
+            wasHitVertical = TRUE;
+            wallHitX = nextVertTouchX;
+            wallHitY = nextVertTouchY;
+            nextVertTouchX += vertStepX;
+            nextVertTouchY += vertStepY;
+            vertColumn += vertColumnStep;
+        } else {
+            row = horzRow;
+            column = (int)(nextHorzTouchX / TILE_SIZE);
+            PROFILE_COUNT(horizontalSteps, 1);
+            wasHitVertical = FALSE;
+            wallHitX = nextHorzTouchX;
+            wallHitY = nextHorzTouchY;
+            nextHorzTouchX += horzStepX;
+            nextHorzTouchY += horzStepY;
+            horzRow += horzRowStep;
+        }
+        hits->end.x = wallHitX;
+        hits->end.y = wallHitY;
+        if (wallHitX < 0 || wallHitX > map.width || wallHitY < 0 || wallHitY > map.height ||
+            row < 0 || row >= map.numRows || column < 0 || column >= map.numCols)
+            break;
+
+        PROFILE_COUNT(wallChecks, 1);
+        int content = mapContentAt(column, row);
+        int height = MAP_FULL_HEIGHT;
+        if (content == MAP_THIN_WALL) {
+            if (!hitThinWall(column, row, rayDir, &wallHitX, &wallHitY, &content, &wasHitVertical))
+                continue;
+        } else if (content != 0)
+            height = mapHeightAt(column, row);
+        if (content == 0)
+            continue;
+
+        // The ray leaves the cell at whichever touch comes next:
+        const int isExitVertical = fabsf(nextVertTouchX - view->position.x) * rayDirY < fabsf(nextHorzTouchY - view->position.y) * rayDirX;
+        const float exitX = isExitVertical ? nextVertTouchX : nextHorzTouchX;
+        const float exitY = isExitVertical ? nextVertTouchY : nextHorzTouchY;
+        const float depth = (wallHitX - view->position.x) * view->orientation.x + (wallHitY - view->position.y) * view->orientation.y;
+        const float exitDepth = (exitX - view->position.x) * view->orientation.x + (exitY - view->position.y) * view->orientation.y;
+        struct WallRows rows;
+        struct WallSpans spans;
+        setWallRows(&rows, depth, exitDepth, height);
+        occludeRows(&open, &rows, &spans);
+
+        // Walls hidden behind nearer ones are left out (but the first wall is always kept, as the ray's own hit):
+        if (spans.wallFirst < spans.wallLast || spans.capFirst < spans.capLast || hits->count == 0) {
+            struct RayHit* hit = &hits->hits[hits->count++];
+            hit->wallHit.x = wallHitX;
+            hit->wallHit.y = wallHitY;
+            hit->exit.x = exitX;
+            hit->exit.y = exitY;
+            hit->content = (uint8_t)content;
+            hit->wasHitVertical = (uint8_t)wasHitVertical;
+            hit->height = (uint8_t)height;
+        }
+    }
+
+    struct Ray* ray = &view->rays[stripId];
+    if (hits->count > 0) {
+        ray->wallHit = hits->hits[0].wallHit;
+        ray->wallHitContent = hits->hits[0].content;
+        ray->wasHitVertical = hits->hits[0].wasHitVertical;
+    }
+    ray->direction = *rayDir;
+}
+
+void recastLowWallHits(int firstStrip, int lastStrip) {
+    // Casts the rays whose first hit is a low wall again, to see past it (after any kernel):
+    if (!map.heights)
+        return;
+    for (int stripId = firstStrip; stripId < lastStrip; stripId++) {
+        view->rayHits[stripId].count = 0;
+        if (isLowWallHit(&view->rays[stripId])) {
+            vec2 direction = view->rays[stripId].direction;
+            castLowWallRay(&direction, stripId);
+        }
+    }
+}
+
+void fillWallTopColumn(Uint32* column, int stride, int firstRow, int lastRow, int height, int content, float unitDepthX, float unitDepthY) {
+    // The top of a wall below the eye is a floor raised to the wall's height, so each row is at the depth of the
+    // floor on that row, scaled by how much closer to the eye the top is (textured like the wall's side):
+    const float scale = (float)(MAP_FULL_HEIGHT - 2 * height) / MAP_FULL_HEIGHT;
+    const int texture = (content ? content - 1 : 0) % NUM_TEXTURES;
+    const Uint32* texels = &wallTextures[(size_t)texture * TEXTURE_SIZE];
+    const uint8_t* indices = &wallTextureIndices[(size_t)texture * TEXTURE_SIZE];
+    firstRow = firstRow > (WINDOW_HEIGHT / 2) ? firstRow : (WINDOW_HEIGHT / 2);
+    for (int y = firstRow; y < lastRow; y++) {
+        const float depth = floor_row_depths[y - (WINDOW_HEIGHT / 2)] * scale;
+        const int textureX = (int)((view->position.x + depth * unitDepthX) * ((float)TEXTURE_WIDTH / TILE_SIZE)) & (TEXTURE_WIDTH - 1);
+        const int textureY = (int)((view->position.y + depth * unitDepthY) * ((float)TEXTURE_HEIGHT / TILE_SIZE)) & (TEXTURE_HEIGHT - 1);
+        const int texel = (textureX * TEXTURE_HEIGHT) + textureY;
+        if (lighting.shading == SHADING_COLORMAP)
+            column[stride * y] = colormaps[lightLevelAt(depth)][indices[texel]];
+        else if (lighting.shading == SHADING_NAIVE)
+            column[stride * y] = shadeColor(texels[texel], lightLevelAt(depth));
+        else
+            column[stride * y] = texels[texel];
+    }
+}
+
+void projectLowWallColumn(int i, Uint32* column, int stride) {
+    // Projects the walls a ray sees over low walls, clipping each to the rows the nearer ones left open, as
+    // castLowWallRay() did. The floor and ceiling in front of every wall are cast first in one go, down from the
+    // first row of floor seen (and up from the mirrored row), and the walls are drawn over them:
+    const struct RayHits* hits = &view->rayHits[i];
+    const float tangent = column_tangents[i];
+    const float unitDepthX = view->orientation.x - tangent * view->orientation.y;
+    const float unitDepthY = view->orientation.y + tangent * view->orientation.x;
+    struct WallSpans spans[MAX_RAY_HITS];
+    float depths[MAX_RAY_HITS];
+    int wallTops[MAX_RAY_HITS];
+    int stripHeights[MAX_RAY_HITS];
+    struct OpenRows open;
+    openAllRows(&open);
+    for (int k = 0; k < hits->count; k++) {
+        const struct RayHit* hit = &hits->hits[k];
+        struct WallRows rows;
+        depths[k] = (hit->wallHit.x - view->position.x) * view->orientation.x + (hit->wallHit.y - view->position.y) * view->orientation.y;
+        const float exitDepth = (hit->exit.x - view->position.x) * view->orientation.x + (hit->exit.y - view->position.y) * view->orientation.y;
+        setWallRows(&rows, depths[k], exitDepth, hit->height);
+        occludeRows(&open, &rows, &spans[k]);
+        wallTops[k] = rows.fullTop;
+        stripHeights[k] = rows.stripHeight;
+    }
+    closeOpenRows(&open);
+    view->zBuffer[i] = depths[0];
+
+    const int mirroredCeilingEnd = WINDOW_HEIGHT - open.ceilingEnd;
+    int floorRow = open.floorStart < mirroredCeilingEnd ? open.floorStart : mirroredCeilingEnd;
+    floorRow = floorRow > (WINDOW_HEIGHT / 2) ? floorRow : (WINDOW_HEIGHT / 2);
+    castFloorColumn(column, stride, floorRow, unitDepthX, unitDepthY);
+
+    for (int k = 0; k < hits->count; k++) {
+        const struct RayHit* hit = &hits->hits[k];
+        if (spans[k].wallFirst < spans[k].wallLast)
+            fillWallColumn(column, stride, spans[k].wallFirst, spans[k].wallLast, wallTops[k], stripHeights[k],
+                hit->content, hit->wasHitVertical, &hit->wallHit, depths[k]);
+        if (spans[k].capFirst < spans[k].capLast)
+            fillWallTopColumn(column, stride, spans[k].capFirst, spans[k].capLast, hit->height, hit->content, unitDepthX, unitDepthY);
+    }
+}
+
+int lowerWalls(int percent, unsigned int seed) {
+    // Lowers that percentage of the walls inside the map's border (other than thin walls) at random, each to a
+    // height between an eighth and seven eighths of full height, returning how many were lowered (or -1):
+    unsigned int random = seed ? seed : 1;
+    int lowered = 0;
+    for (int row = 1; row < map.numRows - 1; row++)
+        for (int column = 1; column < map.numCols - 1; column++) {
+            const int content = mapContentAt(column, row);
+            if (content == 0 || content == MAP_THIN_WALL)
+                continue;
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            if ((int)(random % 100) >= percent)
+                continue;
+            const int height = (MAP_FULL_HEIGHT / 8) + (int)((random / 100) % (unsigned int)(MAP_FULL_HEIGHT * 3 / 4));
+            if (!setMapHeight(column, row, height))
+                return -1;
+            lowered++;
+        }
+    return lowered;
+}
+// =========
@@ -0,0 +1,128 @@
+// Distance shading:
+// =========
+// Walls, floors and ceilings can fade into the dark with their depth, at NUM_LIGHT_LEVELS light levels: the
+// view's ambient level up close, falling by LIGHT_LEVELS_PER_TILE for every tile of depth. Depths are the
+// perpendicular distances the projection already sizes walls by (and the floor's row depths), so a level
+// costs a multiply per column (or none, per floor row), and no square roots.
+// SHADING_COLORMAP shades the way Doom does: the wall textures are quantized to a palette of up to
+// PALETTE_SIZE colors at startup (the most common colors of the atlas, at 4 bits per channel), with the atlas
+// kept as one palette index per texel, and a colormap per light level maps each palette index to its color at
+// that level. Shading a pixel is then a lookup of its texel's color in its column's (or row's) colormap,
+// instead of scaling every channel of its texel.
+// SHADING_NAIVE scales every channel of each texel by its light instead (to compare against), and
+// SHADING_NONE leaves the textures as they are. (Sprites aren't shaded)
+#define NUM_LIGHT_LEVELS 32
+#define LIGHT_LEVELS_PER_TILE 1.5f
+#define PALETTE_SIZE 256
+#define PALETTE_BINS 4096 // 4 bits per channel
+
+enum Shading {
+    SHADING_NONE,
+    SHADING_COLORMAP,
+    SHADING_NAIVE
+};
+const char* shadingNames[] = {"none", "colormap", "naive"};
+
+struct Lighting {
+    int shading;
+    int ambientLevel; // the light level at depth 0
+} lighting = {.shading = SHADING_NONE, .ambientLevel = NUM_LIGHT_LEVELS - 1};
+
+Uint32 palette[PALETTE_SIZE];
+Uint32 colormaps[NUM_LIGHT_LEVELS][PALETTE_SIZE];
+uint8_t* wallTextureIndices = NULL; // the palette index of each texel of wallTextures
+
+int parseShading(const char* name) {
+    for (int shading = 0; shading < (int)(sizeof(shadingNames) / sizeof(shadingNames[0])); shading++)
+        if (!strcmp(name, shadingNames[shading]))
+            return shading;
+    fprintf(stderr, "Error: unknown shading %s.\n", name);
+    return -1;
+}
+
+int lightLevelAt(float depth) {
+    const int level = lighting.ambientLevel - (int)(depth * (LIGHT_LEVELS_PER_TILE / TILE_SIZE));
+    return level < 0 ? 0 : level;
+}
+
+Uint32 shadeColor(Uint32 color, int level) {
+    // Scales every channel by the light of a level, from 1/NUM_LIGHT_LEVELS to all of it:
+    const Uint32 light = (Uint32)(level + 1) * 256 / NUM_LIGHT_LEVELS;
+    return 0xFF000000 | ((((color >> 16) & 0xFF) * light >> 8) << 16) |
+        ((((color >> 8) & 0xFF) * light >> 8) << 8) | ((color & 0xFF) * light >> 8);
+}
+
+int paletteBinOf(Uint32 color) {
+    return (int)(((color >> 12) & 0xF00) | ((color >> 8) & 0xF0) | ((color >> 4) & 0xF));
+}
+
+int colorDistance(Uint32 a, Uint32 b) {
+    const int red = (int)((a >> 16) & 0xFF) - (int)((b >> 16) & 0xFF);
+    const int green = (int)((a >> 8) & 0xFF) - (int)((b >> 8) & 0xFF);
+    const int blue = (int)(a & 0xFF) - (int)(b & 0xFF);
+    return red * red + green * green + blue * blue;
+}
+
+int comparePaletteBins(const void* a, const void* b) {
+    // By how many texels fall in them, most first, then by which bin they are, since qsort() isn't stable and
+    // the palette has to come out the same everywhere:
+    const long long* x = (const long long*)a;
+    const long long* y = (const long long*)b;
+    if (x[0] != y[0])
+        return (x[0] < y[0]) - (x[0] > y[0]);
+    return (x[4] > y[4]) - (x[4] < y[4]);
+}
+
+void buildColormaps() {
+    // After generateTextures(). Each bin is the average of its texels, and the most common bins make up the
+    // palette, with every other bin going to its nearest palette color:
+    const size_t numTexels = (size_t)TEXTURE_SIZE * NUM_TEXTURES * 2;
+    // (per bin: its number of texels, the sums of their red, green and blue, and which bin it is, once sorted)
+    long long (*bins)[5] = (long long (*)[5]) calloc(PALETTE_BINS, sizeof(*bins));
+    int* binIndices = (int*) malloc(sizeof(int) * PALETTE_BINS);
+    wallTextureIndices = (uint8_t*) malloc(numTexels);
+    if (!bins || !binIndices || !wallTextureIndices) {
+        fprintf(stderr, "Error allocating colormaps.\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < numTexels; i++) {
+        const Uint32 color = wallTextures[i];
+        long long* bin = bins[paletteBinOf(color)];
+        bin[0]++;
+        bin[1] += (color >> 16) & 0xFF;
+        bin[2] += (color >> 8) & 0xFF;
+        bin[3] += color & 0xFF;
+    }
+    Uint32 binColors[PALETTE_BINS];
+    for (int i = 0; i < PALETTE_BINS; i++) {
+        const long long count = bins[i][0] > 0 ? bins[i][0] : 1;
+        binColors[i] = 0xFF000000 | (Uint32)(bins[i][1] / count) << 16 | (Uint32)(bins[i][2] / count) << 8 | (Uint32)(bins[i][3] / count);
+        bins[i][4] = i;
+    }
+    qsort(bins, PALETTE_BINS, sizeof(*bins), comparePaletteBins);
+
+    int numColors = 0;
+    for (; numColors < PALETTE_SIZE && bins[numColors][0] > 0; numColors++)
+        palette[numColors] = binColors[bins[numColors][4]];
+    for (int i = 0; i < PALETTE_BINS; i++) {
+        int nearest = 0;
+        for (int color = 1; color < numColors; color++)
+            if (colorDistance(binColors[i], palette[color]) < colorDistance(binColors[i], palette[nearest]))
+                nearest = color;
+        binIndices[i] = nearest;
+    }
+    for (size_t i = 0; i < numTexels; i++)
+        wallTextureIndices[i] = (uint8_t)binIndices[paletteBinOf(wallTextures[i])];
+
+    for (int level = 0; level < NUM_LIGHT_LEVELS; level++)
+        for (int color = 0; color < PALETTE_SIZE; color++)
+            colormaps[level][color] = shadeColor(palette[color], level);
+    free(bins);
+    free(binIndices);
+}
+
+void freeColormaps() {
+    free(wallTextureIndices);
+    wallTextureIndices = NULL;
+}
+// =========
@@ -1,9 +1,22 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
+#include <stdlib.h>
 #include <limits.h>
+#include <float.h>
+#include <math.h>
+#ifdef HEADLESS
+#include <stdint.h>
+typedef uint32_t Uint32;
+#else
 #include <SDL2/SDL.h>
+#endif
 #include "constants.h"
+#include "scheduler.h"
+#include "profile.h"
+#include "workers.h"
+#include "map.h"
 
-const int map[MAP_NUM_ROWS][MAP_NUM_COLS] = {
+const MapCell defaultMap[MAP_NUM_ROWS][MAP_NUM_COLS] = {
     {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 ,1, 1, 1, 1, 1, 1, 1},
     {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
     {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
@@ -64,8 +77,46 @@ void rotate(vec2* v, float amount) {
     setRotationMatrixByAmount(&rotation_matrix, amount);
     multiply(v, &rotation_matrix);
 }
+float addRotationAmounts(float a, float b) {
+    // The amount of a single rotation equivalent to rotating by amount "a" followed by amount "b"
+    // (amounts are half-angle tangents, so they compose by the tangent addition formula):
+    return (a + b) / (1 - a*b);
+}
 // ===========
 
+// How rays are spread over the columns, kept at runtime so it can change while running
+// (the rotation amounts start from FIRST_RAY_DIRECTION and RAY_STEP in setup()):
+enum RayFill {
+    RAY_FILL_NEAREST,    // columns in between cast rays reuse the nearest cast ray
+    RAY_FILL_INTERPOLATE // or, between two rays hitting the same wall, their own hit along that wall
+};
+
+struct Camera {
+    float firstRayDirection; // the rotation amount of the first column's ray
+    float rayStep;           // the rotation amount between the rays of adjacent columns
+    int rayStride;           // rays are cast on every rayStride-th column of a tile (and on its last one)
+    int rayFill;
+} camera = {.rayStride = 1, .rayFill = RAY_FILL_INTERPOLATE};
+
+// The direction of each column's ray in camera space (facing along +x), from its rotation amount. A frame's
+// rays are these rotated by the view's orientation, each on its own, so no ray depends on another's (the
+// screen is split into tiles of adjacent columns that can be cast and filled independently):
+vec2 column_ray_directions[NUM_RAYS];
+
+// The tangent of each column's angle from the player's orientation, derived from its rotation amount "t" as
+// 2t / (1 - t^2), so that (orientation + tangent * perpendicular) is the column's ray scaled to unit depth:
+float column_tangents[NUM_RAYS];
+
+void setColumnRays() {
+    // Whenever the camera's rotation amounts change:
+    float amount = camera.firstRayDirection;
+    for (int stripId = 0; stripId < NUM_RAYS; stripId++) {
+        setRotationVector(&column_ray_directions[stripId], amount);
+        column_tangents[stripId] = (2 * amount) / (1 - amount*amount);
+        amount = addRotationAmounts(amount, camera.rayStep);
+    }
+}
+
 struct Player {
 // Original:
 // =========
@@ -101,21 +152,87 @@ struct Ray {
     vec2 wallHit;
 // =========
     int wasHitVertical;
-    int isRayFacingUp;
-    int isRayFacingDown;
-    int isRayFacingLeft;
-    int isRayFacingRight;
     int wallHitContent;
 } rays[NUM_RAYS];
 
-SDL_Window* window = NULL;
-SDL_Renderer* renderer = NULL;
+// The walls a ray sees, nearest first, once walls lower than the ceiling let it see past its first hit
+// (see heights.h). A ray only has hits of its own when its first hit is a low wall:
+struct RayHit {
+    vec2 wallHit;
+    vec2 exit; // where the ray leaves the wall's cell, for the top of walls below the eye
+    uint8_t content;
+    uint8_t wasHitVertical;
+    uint8_t height;
+};
+
+struct RayHits {
+    int count; // 0 when the ray's own hit is all it sees
+    vec2 end;  // where the ray stopped, behind its last hit
+    struct RayHit hits[MAX_RAY_HITS];
+} rayHits[NUM_RAYS];
+
+// The slopes of the rays being cast, worked out for a whole tile of rays at once before casting them, so the
+// kernels step along the grid without dividing by the ray's components:
+struct RaySlopes {
+    float xPerY[NUM_RAYS]; // rayDir.x / rayDir.y
+    float yPerX[NUM_RAYS]; // rayDir.y / rayDir.x
+} raySlopes;
+
+// The perpendicular distance to the wall of each column, as projected (see sprites.h):
+float zBuffer[NUM_RAYS];
+
+// What a frame is cast from and projected into. The kernels work on the view of the thread they run on,
+// which is the player's (the player's position and orientation as of the frame, rays[] and colorBuffer),
+// unless the thread is rendering a batch of views (see views.h). Views with depth columns are projected into
+// those instead of their color buffer and z-buffer (see depth.h):
+struct View {
+    vec2 position;
+    vec2 orientation;
+    mat2 rotation_matrix;
+    struct Ray* rays;
+    struct RaySlopes* raySlopes;
+    struct RayHits* rayHits;
+    Uint32* colorBuffer;
+    float* zBuffer;
+    struct DepthColumns* depthColumns;
+};
+
+struct View playerView = {.rays = rays, .raySlopes = &raySlopes, .rayHits = rayHits, .zBuffer = zBuffer};
+__thread struct View* view = &playerView;
+
+#include "doors.h"
+#include "packets.h"
+#include "coherence.h"
+#include "resolution.h"
+#include "depth.h"
+#ifdef RAY_KERNEL_FIXED
+#include "fixed.h"
+#endif
+
 int isGameRunning = FALSE;
-int ticksLastFrame;
 
 Uint32* colorBuffer = NULL;
+
+#include "transpose.h"
+#include "textures.h"
+#include "lighting.h"
+#include "floors.h"
+#include "sprites.h"
+#include "agents.h"
+
+#ifndef HEADLESS
+SDL_Window* window = NULL;
+SDL_Renderer* renderer = NULL;
 SDL_Texture* colorBufferTexture;
 
+// The map layer of the minimap is drawn once into its own texture, and only redrawn once the map changes:
+SDL_Texture* minimapTexture = NULL;
+unsigned int minimapVersion = 0;
+int minimapWidth = 0;
+int minimapHeight = 0;
+int minimapRows = 0; // the cells drawn, which the texture may cut short at the window's edge
+int minimapColumns = 0;
+
 int initializeWindow() {
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         fprintf(stderr, "Error initializing SDL.\n");
@@ -133,7 +250,7 @@ int initializeWindow() {
         fprintf(stderr, "Error creating SDL window.\n");
         return FALSE;
     }
-    renderer = SDL_CreateRenderer(window, -1, 0);
+    renderer = SDL_CreateRenderer(window, -1, framePacing == FRAME_PACING_VSYNC ? SDL_RENDERER_PRESENTVSYNC : 0);
     if (!renderer) {
         fprintf(stderr, "Error creating SDL renderer.\n");
         return FALSE;
@@ -144,13 +261,23 @@ int initializeWindow() {
 }
 
 void destroyWindow() {
+    stopWorkers();
     free(colorBuffer);
+    freeTextures();
+    freeColormaps();
+    unloadMap();
+    if (minimapTexture)
+        SDL_DestroyTexture(minimapTexture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
+#endif
 
 void setup() {
+    if (!map.cells)
+        setMap(MAP_NUM_COLS, MAP_NUM_ROWS, &defaultMap[0][0]);
+
 // Original:
 // =========
 //  player.x = WINDOW_WIDTH / 2;
@@ -160,8 +287,8 @@ void setup() {
 //
 // Rational:
 // =========
-    player.position.x = WINDOW_WIDTH / 2;
-    player.position.y = WINDOW_HEIGHT / 2;
+    player.position.x = map.width / 2;
+    player.position.y = map.height / 2;
     player.orientation.x = -1;
     player.orientation.y = 0;
     player.turnSpeed = 1;
@@ -172,9 +299,33 @@ void setup() {
     player.walkDirection = 0;
     player.walkSpeed = 100;
 
-    // allocate the total amount of bytes in memory to hold our colorbuffer
-    colorBuffer = (Uint32*) malloc(sizeof(Uint32) * (Uint32)WINDOW_WIDTH * (Uint32)WINDOW_HEIGHT);
+    camera.firstRayDirection = FIRST_RAY_DIRECTION;
+    camera.rayStep = RAY_STEP;
+    setColumnRays();
+    setRayStepAmounts();
+#ifdef RAY_KERNEL_FIXED
+    setFixedColumnTileRotations();
+#endif
+    selectPacketKernel(maxPacketWidth);
+    selectAgentKernel(maxPacketWidth);
+    selectTransposeKernel();
+    generateTextures();
+    if (lighting.shading == SHADING_COLORMAP)
+        buildColormaps();
+    setFloorRowDepths();
+    selectFloorKernel();
+    PROFILE_START();
+    startWorkers(numWorkers ? numWorkers : countCores());
 
+    // allocate the total amount of bytes in memory to hold our colorbuffer
+    // (aligned to a cache line, so the rows of column tiles can be streamed as whole lines)
+    void* pixels = NULL;
+    if (posix_memalign(&pixels, 64, sizeof(Uint32) * (Uint32)WINDOW_WIDTH * (Uint32)WINDOW_HEIGHT) != 0)
+        pixels = NULL;
+    colorBuffer = (Uint32*) pixels;
+    playerView.colorBuffer = colorBuffer;
+
+#ifndef HEADLESS
     // create an SDL_Texture to display the colorbuffer
     colorBufferTexture = SDL_CreateTexture(
         renderer,
@@ -183,18 +334,34 @@ void setup() {
         WINDOW_WIDTH,
         WINDOW_HEIGHT
     );
+#endif
 }
 
 int mapHasWallAt(float x, float y) {
-    if (x < 0 || x > WINDOW_WIDTH || y < 0 || y > WINDOW_HEIGHT) {
+    PROFILE_COUNT(wallChecks, 1);
+    if (x < 0 || x >= map.width || y < 0 || y >= map.height) {
         return TRUE;
     }
-    int mapGridIndexX = floor(x / TILE_SIZE);
-    int mapGridIndexY = floor(y / TILE_SIZE);
-    return map[mapGridIndexY][mapGridIndexX] != 0;
+    // Coordinates inside the map are never negative, so truncation is the same as floor():
+    int mapGridIndexX = (int)(x * (1.0f / TILE_SIZE));
+    int mapGridIndexY = (int)(y * (1.0f / TILE_SIZE));
+    return mapContentAt(mapGridIndexX, mapGridIndexY) != 0;
+}
+
+int wallContentAt(float x, float y, int* content) {
+    // As mapHasWallAt(), but also storing the content of the wall, which is 0 outside of the map (maps don't
+    // need walls around their border, so rays can run off their edge):
+    PROFILE_COUNT(wallChecks, 1);
+    if (x < 0 || x >= map.width || y < 0 || y >= map.height) {
+        *content = 0;
+        return TRUE;
+    }
+    *content = mapContentAt((int)(x * (1.0f / TILE_SIZE)), (int)(y * (1.0f / TILE_SIZE)));
+    return *content != 0;
 }
 
 void movePlayer(float deltaTime) {
+    PROFILE_BEGIN(PROFILE_MOVE_PLAYER);
     float moveStep = player.walkDirection * player.walkSpeed * deltaTime;
 // Original:
 // =========
@@ -204,19 +371,32 @@ void movePlayer(float deltaTime) {
 //
 // Rational:
 // =========
-    rotate(&player.orientation, player.turnDirection * player.turnSpeed * deltaTime);
+    if (coherence.isEnabled)
+        turnByRaySteps(player.turnDirection * player.turnSpeed * deltaTime);
+    else
+        rotate(&player.orientation, player.turnDirection * player.turnSpeed * deltaTime);
     float newPlayerX = player.position.x + player.orientation.x * moveStep;
     float newPlayerY = player.position.y + player.orientation.y * moveStep;
 
     setRotationMatrix(&player.rotation_matrix, &player.orientation);
 // =========
 
-    if (!mapHasWallAt(newPlayerX, newPlayerY)) {
+    if ((!mapHasWallAt(newPlayerX, newPlayerY) || isThinWallAt(newPlayerX, newPlayerY)) &&
+        !isThinWallInTheWay(player.position.x, player.position.y, newPlayerX, newPlayerY)) {
         player.position.x = newPlayerX;
         player.position.y = newPlayerY;
     }
+    PROFILE_END(PROFILE_MOVE_PLAYER);
+}
+
+void tickSimulation(float deltaTime) {
+    // A fixed tick of everything that moves:
+    movePlayer(deltaTime);
+    moveThinWalls(deltaTime);
+    stepAgents(deltaTime);
 }
 
+#ifndef HEADLESS
 void renderPlayer() {
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
     SDL_Rect playerRect = {
@@ -245,6 +425,7 @@ void renderPlayer() {
 // =========
     );
 }
+#endif
 
 // Original:
 // =========
@@ -278,6 +459,9 @@ float squaredDistanceBetweenPoints(float x1, float y1, float x2, float y2) {
 // Rational:
 // =========
 void castRay(vec2* rayDir, int stripId) {
+    PROFILE_COUNT(rays, 1);
+    if (castViewCellThinWall(rayDir, stripId))
+        return;
     int isRayFacingDown = rayDir->y > 0;
     int isRayFacingRight = rayDir->x > 0;
 // =========
@@ -294,9 +478,10 @@ void castRay(vec2* rayDir, int stripId) {
     float horzWallHitX = 0;
     float horzWallHitY = 0;
     int horzWallContent = 0;
+    int horzWasHitVertical = FALSE; // (unless the wall hit is a thin wall along a vertical line)
 
     // Find the y-coordinate of the closest horizontal grid intersection
-    yintercept = floor(player.position.y / TILE_SIZE) * TILE_SIZE;
+    yintercept = floor(view->position.y / TILE_SIZE) * TILE_SIZE;
     yintercept += isRayFacingDown ? TILE_SIZE : 0;
 
 // Original:
@@ -310,10 +495,11 @@ void castRay(vec2* rayDir, int stripId) {
 // Rational:
 // =========
     // Find the x-coordinate of the closest horizontal grid intersection
-    xintercept = player.position.x + (yintercept - player.position.y) * rayDir->x / rayDir->y;
+    const float xPerY = view->raySlopes->xPerY[stripId];
+    xintercept = view->position.x + (yintercept - view->position.y) * xPerY;
 
     // Calculate the increment xstep and ystep
-    xstep = TILE_SIZE * rayDir->x / rayDir->y;
+    xstep = TILE_SIZE * xPerY;
 // ========
     xstep *= (isRayFacingLeft && xstep > 0) ? -1 : 1;
     xstep *= (isRayFacingRight && xstep < 0) ? -1 : 1;
@@ -325,16 +511,20 @@ void castRay(vec2* rayDir, int stripId) {
     float nextHorzTouchY = yintercept;
 
     // Increment xstep and ystep until we find a wall
-    while (nextHorzTouchX >= 0 && nextHorzTouchX <= WINDOW_WIDTH && nextHorzTouchY >= 0 && nextHorzTouchY <= WINDOW_HEIGHT) {
+    while (nextHorzTouchX >= 0 && nextHorzTouchX <= map.width && nextHorzTouchY >= 0 && nextHorzTouchY <= map.height) {
         float xToCheck = nextHorzTouchX;
         float yToCheck = nextHorzTouchY + (isRayFacingUp ? -1 : 0);
+        PROFILE_COUNT(horizontalSteps, 1);
 
-        if (mapHasWallAt(xToCheck, yToCheck)) {
+        if (wallContentAt(xToCheck, yToCheck, &horzWallContent)) {
             // found a wall hit
             horzWallHitX = nextHorzTouchX;
             horzWallHitY = nextHorzTouchY;
-            horzWallContent = map[(int)floor(yToCheck / TILE_SIZE)][(int)floor(xToCheck / TILE_SIZE)];
-            foundHorzWallHit = TRUE;
+            foundHorzWallHit = horzWallContent != MAP_THIN_WALL ||
+                hitThinWall((int)floor(xToCheck / TILE_SIZE), (int)floor(yToCheck / TILE_SIZE), rayDir,
+                    &horzWallHitX, &horzWallHitY, &horzWallContent, &horzWasHitVertical);
+        }
+        if (foundHorzWallHit) {
             break;
         } else {
             nextHorzTouchX += xstep;
@@ -349,9 +539,10 @@ void castRay(vec2* rayDir, int stripId) {
     float vertWallHitX = 0;
     float vertWallHitY = 0;
     int vertWallContent = 0;
+    int vertWasHitVertical = TRUE;
 
     // Find the x-coordinate of the closest vertical grid intersection
-    xintercept = floor(player.position.x / TILE_SIZE) * TILE_SIZE;
+    xintercept = floor(view->position.x / TILE_SIZE) * TILE_SIZE;
     xintercept += isRayFacingRight ? TILE_SIZE : 0;
 
 // Original:
@@ -364,10 +555,11 @@ void castRay(vec2* rayDir, int stripId) {
 // Rational:
 // =========
     // Find the y-coordinate of the closest horizontal grid intersection
-    yintercept = player.position.y + (xintercept - player.position.x) * rayDir->y / rayDir->x;
+    const float yPerX = view->raySlopes->yPerX[stripId];
+    yintercept = view->position.y + (xintercept - view->position.x) * yPerX;
 
     // Calculate the increment xstep and ystep
-    ystep = TILE_SIZE * rayDir->y / rayDir->x;
+    ystep = TILE_SIZE * yPerX;
 // ========
     ystep *= (isRayFacingUp && ystep > 0) ? -1 : 1;
     ystep *= (isRayFacingDown && ystep < 0) ? -1 : 1;
@@ -379,16 +571,20 @@ void castRay(vec2* rayDir, int stripId) {
     float nextVertTouchY = yintercept;
 
     // Increment xstep and ystep until we find a wall
-    while (nextVertTouchX >= 0 && nextVertTouchX <= WINDOW_WIDTH && nextVertTouchY >= 0 && nextVertTouchY <= WINDOW_HEIGHT) {
+    while (nextVertTouchX >= 0 && nextVertTouchX <= map.width && nextVertTouchY >= 0 && nextVertTouchY <= map.height) {
         float xToCheck = nextVertTouchX + (isRayFacingLeft ? -1 : 0);
         float yToCheck = nextVertTouchY;
+        PROFILE_COUNT(verticalSteps, 1);
 
-        if (mapHasWallAt(xToCheck, yToCheck)) {
+        if (wallContentAt(xToCheck, yToCheck, &vertWallContent)) {
             // found a wall hit
             vertWallHitX = nextVertTouchX;
             vertWallHitY = nextVertTouchY;
-            vertWallContent = map[(int)floor(yToCheck / TILE_SIZE)][(int)floor(xToCheck / TILE_SIZE)];
-            foundVertWallHit = TRUE;
+            foundVertWallHit = vertWallContent != MAP_THIN_WALL ||
+                hitThinWall((int)floor(xToCheck / TILE_SIZE), (int)floor(yToCheck / TILE_SIZE), rayDir,
+                    &vertWallHitX, &vertWallHitY, &vertWallContent, &vertWasHitVertical);
+        }
+        if (foundVertWallHit) {
             break;
         } else {
             nextVertTouchX += xstep;
@@ -405,8 +601,9 @@ void castRay(vec2* rayDir, int stripId) {
 // Rational:
 // =========
     // Calculate both horizontal and vertical hit distances and choose the smallest one
-    float horzHitDistance = foundHorzWallHit ? squaredDistanceBetweenPoints(player.position.x, player.position.y, horzWallHitX, horzWallHitY) : INT_MAX;
-    float vertHitDistance = foundVertWallHit ? squaredDistanceBetweenPoints(player.position.x, player.position.y, vertWallHitX, vertWallHitY) : INT_MAX;
+    // (squared distances across large maps exceed INT_MAX, so a missing hit is FLT_MAX away)
+    float horzHitDistance = foundHorzWallHit ? squaredDistanceBetweenPoints(view->position.x, view->position.y, horzWallHitX, horzWallHitY) : FLT_MAX;
+    float vertHitDistance = foundVertWallHit ? squaredDistanceBetweenPoints(view->position.x, view->position.y, vertWallHitX, vertWallHitY) : FLT_MAX;
 // ========
 
     if (vertHitDistance < horzHitDistance) {
@@ -418,11 +615,11 @@ void castRay(vec2* rayDir, int stripId) {
 //
 // Rational:
 // =========
-        rays[stripId].wallHit.x = vertWallHitX;
-        rays[stripId].wallHit.y = vertWallHitY;
+        view->rays[stripId].wallHit.x = vertWallHitX;
+        view->rays[stripId].wallHit.y = vertWallHitY;
 // ========
-        rays[stripId].wallHitContent = vertWallContent;
-        rays[stripId].wasHitVertical = TRUE;
+        view->rays[stripId].wallHitContent = vertWallContent;
+        view->rays[stripId].wasHitVertical = vertWasHitVertical;
     } else {
 // Original:
 // =========
@@ -432,11 +629,11 @@ void castRay(vec2* rayDir, int stripId) {
 //
 // Rational:
 // =========
-        rays[stripId].wallHit.x = horzWallHitX;
-        rays[stripId].wallHit.y = horzWallHitY;
+        view->rays[stripId].wallHit.x = horzWallHitX;
+        view->rays[stripId].wallHit.y = horzWallHitY;
 // ========
-        rays[stripId].wallHitContent = horzWallContent;
-        rays[stripId].wasHitVertical = FALSE;
+        view->rays[stripId].wallHitContent = horzWallContent;
+        view->rays[stripId].wasHitVertical = horzWasHitVertical;
     }
 
 // Original:
@@ -445,31 +642,154 @@ void castRay(vec2* rayDir, int stripId) {
 //
 // Rational:
 // =========
-    rays[stripId].direction.x = rayDir->x;
-    rays[stripId].direction.y = rayDir->y;
+    view->rays[stripId].direction.x = rayDir->x;
+    view->rays[stripId].direction.y = rayDir->y;
 // ========
-    rays[stripId].isRayFacingDown = isRayFacingDown;
-    rays[stripId].isRayFacingUp = isRayFacingUp;
-    rays[stripId].isRayFacingLeft = isRayFacingLeft;
-    rays[stripId].isRayFacingRight = isRayFacingRight;
 }
 
-void castAllRays() {
+#ifdef RAY_KERNEL_DDA
+#include "dda.h"
+#define CAST_RAY castRayDDA
+#else
+#define CAST_RAY castRay
+#endif
+
+void setRaySlopes(const vec2* directions, int firstStrip, int count) {
+    // The slopes of the rays about to be cast on count strips from firstStrip, in one pass the compiler can
+    // vectorize:
+    float* xPerY = &view->raySlopes->xPerY[firstStrip];
+    float* yPerX = &view->raySlopes->yPerX[firstStrip];
+    for (int i = 0; i < count; i++) {
+        xPerY[i] = directions[i].x / directions[i].y;
+        yPerX[i] = directions[i].y / directions[i].x;
+    }
+}
+
+void recastThinWallHits(int firstStrip, int lastStrip) {
+    // The kernels that don't know about thin walls end rays on the first thin wall cell they find, as if it were
+    // a wall, so those rays are cast again by the float kernel, which goes through the cell when it misses
+    // (and they don't see a thin wall in the view's own cell either, which is in front of whatever they hit):
+    for (int stripId = firstStrip; stripId < lastStrip && thinWalls.count > 0; stripId++) {
+        vec2 direction = view->rays[stripId].direction;
+        if (castViewCellThinWall(&direction, stripId))
+            continue;
+        if (view->rays[stripId].wallHitContent == MAP_THIN_WALL) {
+            vec2 direction = view->rays[stripId].direction;
+            setRaySlopes(&direction, stripId, 1);
+            CAST_RAY(&direction, stripId);
+        }
+    }
+}
+
+void fillWallColumn(Uint32* column, int stride, int firstRow, int lastRow, int wallTopPixel, int wallStripHeight,
+                    int content, int wasHitVertical, const vec2* wallHit, float perpDistance) {
+    // Fills rows firstRow to lastRow of a wall strip starting at wallTopPixel (which can be off the screen):
+    // The texture column comes from where the wall was hit along the grid line, and the darker copy
+    // of the texture is used for walls hit on horizontal grid lines:
+    const int texture = (content ? content - 1 : 0) % NUM_TEXTURES + (wasHitVertical ? 0 : NUM_TEXTURES);
+    const float wallOffset = wasHitVertical ? wallHit->y : wallHit->x;
+    const int textureOffsetX = ((int)wallOffset % TILE_SIZE) * TEXTURE_WIDTH / TILE_SIZE;
+    const Uint32* texels = &wallTextures[(size_t)((texture * TEXTURE_WIDTH) + textureOffsetX) * TEXTURE_HEIGHT];
+
+    // One divide per column, then fixed-point steps down the texture column
+    // (starting part way down it when the wall is clipped):
+    const Uint32 textureStep = (Uint32)(((uint64_t)TEXTURE_HEIGHT << TEXTURE_V_BITS) / (uint64_t)wallStripHeight);
+    Uint32 textureY = (Uint32)(firstRow - wallTopPixel) * textureStep;
+    if (lighting.shading == SHADING_COLORMAP) {
+        // The column's texels are palette indices, looked up in the colormap of the column's light level:
+        const uint8_t* indices = &wallTextureIndices[texels - wallTextures];
+        const Uint32* colormap = colormaps[lightLevelAt(perpDistance)];
+        for (int y = firstRow; y < lastRow; y++) {
+            column[stride * y] = colormap[indices[textureY >> TEXTURE_V_BITS]];
+            textureY += textureStep;
+        }
+    } else if (lighting.shading == SHADING_NAIVE) {
+        const int level = lightLevelAt(perpDistance);
+        for (int y = firstRow; y < lastRow; y++) {
+            column[stride * y] = shadeColor(texels[textureY >> TEXTURE_V_BITS], level);
+            textureY += textureStep;
+        }
+    } else {
+        for (int y = firstRow; y < lastRow; y++) {
+            column[stride * y] = texels[textureY >> TEXTURE_V_BITS];
+            textureY += textureStep;
+        }
+    }
+}
+
+#include "heights.h"
+
+void castTile(int tile) {
+    const int firstStrip = tile * COLUMN_TILE_WIDTH;
+    const int lastStrip = firstStrip + COLUMN_TILE_WIDTH < NUM_RAYS ? firstStrip + COLUMN_TILE_WIDTH : NUM_RAYS;
+#ifdef RAY_KERNEL_FIXED
+    castTileFixed(tile);
+    recastThinWallHits(firstStrip, lastStrip);
+    recastLowWallHits(firstStrip, lastStrip);
+    return;
+#endif
+    vec2 directions[COLUMN_TILE_WIDTH];
+
 // Original:
 // =========
 //  float rayAngle = player.rotationAngle - (FOV_ANGLE / 2);
 //
 // Rational:
 // =========
-    setRotationVector(&ray_direction, FIRST_RAY_DIRECTION);
-    multiply(&ray_direction, &player.rotation_matrix);
-
-    // Construct a rotation matrix for rotating a 2D direction
-    // from the current-ray's direction to the next ray's direction:
-    setRotationMatrixByAmount(&rotation_matrix, RAY_STEP);
+    // The camera's rays of the tile, rotated by the view's orientation (as multiply() does):
+    const mat2 rotation = view->rotation_matrix;
+    for (int i = 0; i < lastStrip - firstStrip; i++) {
+        const vec2 ray = column_ray_directions[firstStrip + i];
+        directions[i].x = rotation.m11*ray.x + rotation.m21*ray.y;
+        directions[i].y = rotation.m12*ray.x + rotation.m22*ray.y;
+    }
 // =========
 
-    for (int stripId = 0; stripId < NUM_RAYS; stripId++) {
+    if (camera.rayStride > 1) {
+        // Only every rayStride-th strip and the last one, with the ones in between filled from them.
+        // Their rays are cast next to each other at the start of the tile (so packets still apply), then
+        // spread out to their own strips, starting from the last, since they only ever move right:
+        vec2 castDirections[COLUMN_TILE_WIDTH];
+        int castStrips[COLUMN_TILE_WIDTH];
+        int numCastStrips = 0;
+        for (int stripId = firstStrip; stripId < lastStrip; stripId += camera.rayStride)
+            castStrips[numCastStrips++] = stripId;
+        if (castStrips[numCastStrips - 1] != lastStrip - 1)
+            castStrips[numCastStrips++] = lastStrip - 1;
+        for (int i = 0; i < numCastStrips; i++)
+            castDirections[i] = directions[castStrips[i] - firstStrip];
+        setRaySlopes(castDirections, firstStrip, numCastStrips);
+
+        int i = 0;
+        if (castRayPacket)
+            for (; i + packetWidth <= numCastStrips; i += packetWidth)
+                castRayPacket(&castDirections[i], firstStrip + i);
+        for (; i < numCastStrips; i++)
+            CAST_RAY(&castDirections[i], firstStrip + i);
+        if (castRayPacket)
+            recastThinWallHits(firstStrip, firstStrip + numCastStrips);
+        for (i = numCastStrips - 1; i > 0; i--)
+            view->rays[castStrips[i]] = view->rays[firstStrip + i];
+
+        for (int stripId = firstStrip; stripId < lastStrip; stripId++)
+            view->rays[stripId].direction = directions[stripId - firstStrip];
+        fillRayGaps(firstStrip, lastStrip);
+        recastLowWallHits(firstStrip, lastStrip);
+        return;
+    }
+
+    // Only the strips the coherence cache couldn't reuse from the last frame:
+    int firstCastStrip, lastCastStrip;
+    getTileCastRange(firstStrip, lastStrip, &firstCastStrip, &lastCastStrip);
+    setRaySlopes(&directions[firstCastStrip - firstStrip], firstCastStrip, lastCastStrip - firstCastStrip);
+    int stripId = firstCastStrip;
+    if (castRayPacket) {
+        for (; stripId + packetWidth <= lastCastStrip; stripId += packetWidth)
+            castRayPacket(&directions[stripId - firstStrip], stripId);
+        recastThinWallHits(firstCastStrip, stripId);
+    }
+
+    for (; stripId < lastCastStrip; stripId++) {
 // Original:
 // =========
 //      castRay(rayAngle, stripId);
@@ -477,45 +797,164 @@ void castAllRays() {
 //
 // Rational:
 // =========
-        castRay(&ray_direction, stripId);
-        multiply(&ray_direction, &rotation_matrix);
+        CAST_RAY(&directions[stripId - firstStrip], stripId);
 // =========
     }
+    recastLowWallHits(firstCastStrip, lastCastStrip);
 }
 
-void renderMap() {
-    for (int i = 0; i < MAP_NUM_ROWS; i++) {
-        for (int j = 0; j < MAP_NUM_COLS; j++) {
-            int tileX = j * TILE_SIZE;
-            int tileY = i * TILE_SIZE;
-            int tileColor = map[i][j] != 0 ? 255 : 0;
-
-            SDL_SetRenderDrawColor(renderer, tileColor, tileColor, tileColor, 255);
-            SDL_Rect mapTileRect = {
-                tileX * MINIMAP_SCALE_FACTOR,
-                tileY * MINIMAP_SCALE_FACTOR,
-                TILE_SIZE * MINIMAP_SCALE_FACTOR,
-                TILE_SIZE * MINIMAP_SCALE_FACTOR
-            };
-            SDL_RenderFillRect(renderer, &mapTileRect);
+void setPlayerView() {
+    // The player's view of this frame (movePlayer() only moves the player):
+    playerView.position = player.position;
+    playerView.orientation = player.orientation;
+    playerView.rotation_matrix = player.rotation_matrix;
+}
+
+void castAllRays() {
+    PROFILE_BEGIN(PROFILE_CAST_ALL_RAYS);
+    setPlayerView();
+    beginCoherentFrame();
+    if (!coherence.isFrameSkipped)
+        runWorkers(castTile, NUM_COLUMN_TILES);
+    PROFILE_END(PROFILE_CAST_ALL_RAYS);
+}
+
+#ifndef HEADLESS
+int setMinimapWallRect(int column, int row, SDL_Rect* rect) {
+    // The rectangle of the minimap covered by a cell's wall, if any (thin walls are drawn as a line, of the part
+    // that isn't open):
+    const int content = mapContentAt(column, row);
+    rect->x = column * TILE_SIZE * MINIMAP_SCALE_FACTOR;
+    rect->y = row * TILE_SIZE * MINIMAP_SCALE_FACTOR;
+    rect->w = rect->h = TILE_SIZE * MINIMAP_SCALE_FACTOR;
+    if (content != MAP_THIN_WALL)
+        return content != 0;
+
+    const struct ThinWall* wall = findThinWall(column, row);
+    if (!wall || wall->openFraction >= 1)
+        return FALSE;
+    const int open = (int)(wall->openFraction * TILE_SIZE * MINIMAP_SCALE_FACTOR);
+    const int inset = (int)(wall->inset * TILE_SIZE * MINIMAP_SCALE_FACTOR);
+    if (wall->isVertical) {
+        rect->x += inset;
+        rect->y += open;
+        rect->w = 1;
+        rect->h -= open;
+    } else {
+        rect->x += open;
+        rect->y += inset;
+        rect->w -= open;
+        rect->h = 1;
+    }
+    return TRUE;
+}
+
+int updateMinimapTexture() {
+    // Only the part of the map that fits in the window is drawn:
+    const int numRows = (int)ceil(WINDOW_HEIGHT / (TILE_SIZE * MINIMAP_SCALE_FACTOR)) < map.numRows ?
+        (int)ceil(WINDOW_HEIGHT / (TILE_SIZE * MINIMAP_SCALE_FACTOR)) : map.numRows;
+    const int numCols = (int)ceil(WINDOW_WIDTH / (TILE_SIZE * MINIMAP_SCALE_FACTOR)) < map.numCols ?
+        (int)ceil(WINDOW_WIDTH / (TILE_SIZE * MINIMAP_SCALE_FACTOR)) : map.numCols;
+    const int width = (int)(numCols * TILE_SIZE * MINIMAP_SCALE_FACTOR);
+    const int height = (int)(numRows * TILE_SIZE * MINIMAP_SCALE_FACTOR);
+    minimapRows = numRows;
+    minimapColumns = numCols;
+
+    if (!minimapTexture || width != minimapWidth || height != minimapHeight) {
+        if (minimapTexture)
+            SDL_DestroyTexture(minimapTexture);
+        minimapTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+        if (!minimapTexture) {
+            fprintf(stderr, "Error creating the minimap texture: %s\n", SDL_GetError());
+            return FALSE;
         }
+        minimapWidth = width;
+        minimapHeight = height;
     }
+
+    // Empty cells are the background, and all the walls are filled in a single batch:
+    SDL_Rect* wallRects = (SDL_Rect*) malloc(sizeof(SDL_Rect) * (size_t)numRows * (size_t)numCols);
+    if (!wallRects) {
+        fprintf(stderr, "Error allocating the minimap's walls.\n");
+        return FALSE;
+    }
+    int numWalls = 0;
+    for (int i = 0; i < numRows; i++)
+        for (int j = 0; j < numCols; j++)
+            numWalls += setMinimapWallRect(j, i, &wallRects[numWalls]);
+
+    SDL_SetRenderTarget(renderer, minimapTexture);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderFillRects(renderer, wallRects, numWalls);
+    SDL_SetRenderTarget(renderer, NULL);
+    free(wallRects);
+
+    minimapVersion = map.version;
+    return TRUE;
 }
 
+void updateMinimapCells(int edits) {
+    // Draws the cells of the last edits of the map again, over the minimap texture, clipped to the cells it was
+    // built with:
+    SDL_SetRenderTarget(renderer, minimapTexture);
+    for (int edit = 0; edit < edits; edit++) {
+        const struct MapRegion* region = getMapEdit(edit);
+        for (int i = region->firstRow; i <= region->lastRow && i < minimapRows; i++)
+            for (int j = region->firstColumn; j <= region->lastColumn && j < minimapColumns; j++) {
+                SDL_Rect rect = {
+                    j * TILE_SIZE * MINIMAP_SCALE_FACTOR,
+                    i * TILE_SIZE * MINIMAP_SCALE_FACTOR,
+                    TILE_SIZE * MINIMAP_SCALE_FACTOR,
+                    TILE_SIZE * MINIMAP_SCALE_FACTOR
+                };
+                SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+                SDL_RenderFillRect(renderer, &rect);
+                if (setMinimapWallRect(j, i, &rect)) {
+                    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+                    SDL_RenderFillRect(renderer, &rect);
+                }
+            }
+    }
+    SDL_SetRenderTarget(renderer, NULL);
+    minimapVersion = map.version;
+}
+
+void renderMap() {
+    // Only the cells the map's edits changed are drawn again, unless they're no longer all in its log:
+    const int edits = minimapTexture ? countMapEditsSince(minimapVersion) : -1;
+    if (edits > 0)
+        updateMinimapCells(edits);
+    else if (edits < 0 && !updateMinimapTexture())
+        return;
+
+    SDL_Rect minimapRect = {0, 0, minimapWidth, minimapHeight};
+    SDL_RenderCopy(renderer, minimapTexture, NULL, &minimapRect);
+}
 void renderRays() {
-    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+    // All rays are drawn as a single polyline, going from the player out to each wall hit and back:
+    static SDL_Point rayPoints[(2 * NUM_RAYS) + 1];
+    const SDL_Point playerPoint = {
+        MINIMAP_SCALE_FACTOR * player.position.x,
+        MINIMAP_SCALE_FACTOR * player.position.y
+    };
+    rayPoints[0] = playerPoint;
     for (int i = 0; i < NUM_RAYS; i++) {
-        SDL_RenderDrawLine(
-            renderer,
-            MINIMAP_SCALE_FACTOR * player.position.x,
-            MINIMAP_SCALE_FACTOR * player.position.y,
+        SDL_Point wallHitPoint = {
             MINIMAP_SCALE_FACTOR * rays[i].wallHit.x,
             MINIMAP_SCALE_FACTOR * rays[i].wallHit.y
-        );
+        };
+        rayPoints[(2 * i) + 1] = wallHitPoint;
+        rayPoints[(2 * i) + 2] = playerPoint;
     }
+
+    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+    SDL_RenderDrawLines(renderer, rayPoints, (2 * NUM_RAYS) + 1);
 }
 
 void processInput() {
+    PROFILE_BEGIN(PROFILE_PROCESS_INPUT);
     SDL_Event event;
     SDL_PollEvent(&event);
     switch (event.type) {
@@ -548,66 +987,126 @@ void processInput() {
             break;
         }
     }
+    PROFILE_END(PROFILE_PROCESS_INPUT);
 }
 
-void update() {
-    // waste some time until we reach the target frame time length
-    while (!SDL_TICKS_PASSED(SDL_GetTicks(), ticksLastFrame + FRAME_TIME_LENGTH));
-
-    float deltaTime = (SDL_GetTicks() - ticksLastFrame) / 1000.0f;
-
-    ticksLastFrame = SDL_GetTicks();
-
-    movePlayer(deltaTime);
-    castAllRays();
+int update() {
+    // catch the simulation up with the time passed since the last frame, in fixed ticks
+    const int ticks = runSimulationTicks(tickSimulation);
+    // cast fewer or more rays, depending on how long the last frame took to cast and project
+    adjustRayStride(resolution.lastFrameTime);
+    return ticks;
 }
+#endif
 
-void generate3DProjection() {
-    for (int i = 0; i < NUM_RAYS; i++) {
+void projectColumn(int i, Uint32* column, int stride) {
+    // Fills the column of pixels of ray i, stride pixels apart in the given buffer:
+    if (map.heights && view->rayHits[i].count > 0) {
+        projectLowWallColumn(i, column, stride);
+        return;
+    }
+    vec2 direction;
 // Original:
 // =========
-//      float perpDistance = rays[i].distance * cos(rays[i].rayAngle - player.rotationAngle);
-//      float distanceProjPlane = (WINDOW_WIDTH / 2) / tan(FOV_ANGLE / 2);
+//  float perpDistance = rays[i].distance * cos(rays[i].rayAngle - player.rotationAngle);
+//  float distanceProjPlane = (WINDOW_WIDTH / 2) / tan(FOV_ANGLE / 2);
 //
 // Rational:
 // =========
-        setDirection(&ray_direction, &player.position, &rays[i].wallHit);
-        float perpDistance = dot(&ray_direction, &player.orientation);
-        float distanceProjPlane = (WINDOW_WIDTH / 2) * (FOCAL_LENGTH / 2);
+    setDirection(&direction, &view->position, &view->rays[i].wallHit);
+    float perpDistance = dot(&direction, &view->orientation);
+    float distanceProjPlane = (WINDOW_WIDTH / 2) * (FOCAL_LENGTH / 2);
 // =========
+    view->zBuffer[i] = perpDistance;
 
-        float projectedWallHeight = (TILE_SIZE / perpDistance) * distanceProjPlane;
+    float projectedWallHeight = (TILE_SIZE / perpDistance) * distanceProjPlane;
 
-        int wallStripHeight = (int)projectedWallHeight;
+    int wallStripHeight = (int)projectedWallHeight;
 
-        int wallTopPixel = (WINDOW_HEIGHT / 2) - (wallStripHeight / 2);
-        wallTopPixel = wallTopPixel < 0 ? 0 : wallTopPixel;
+    int wallTopPixel = (WINDOW_HEIGHT / 2) - (wallStripHeight / 2);
+    wallTopPixel = wallTopPixel < 0 ? 0 : wallTopPixel;
 
-        int wallBottomPixel = (WINDOW_HEIGHT / 2) + (wallStripHeight / 2);
-        wallBottomPixel = wallBottomPixel > WINDOW_HEIGHT ? WINDOW_HEIGHT : wallBottomPixel;
+    int wallBottomPixel = (WINDOW_HEIGHT / 2) + (wallStripHeight / 2);
+    wallBottomPixel = wallBottomPixel > WINDOW_HEIGHT ? WINDOW_HEIGHT : wallBottomPixel;
 
-        // set the color of the ceiling
-        for (int y = 0; y < wallTopPixel; y++)
-            colorBuffer[(WINDOW_WIDTH * y) + i] = 0xFF333333;
+    // render the wall from wallTopPixel to wallBottomPixel
+    if (wallTopPixel < wallBottomPixel)
+        fillWallColumn(column, stride, wallTopPixel, wallBottomPixel, (WINDOW_HEIGHT / 2) - (wallStripHeight / 2), wallStripHeight,
+            view->rays[i].wallHitContent, view->rays[i].wasHitVertical, &view->rays[i].wallHit, perpDistance);
 
-        // render the wall from wallTopPixel to wallBottomPixel
-        for (int y = wallTopPixel; y < wallBottomPixel; y++) {
-            colorBuffer[(WINDOW_WIDTH * y) + i] = rays[i].wasHitVertical ? 0xFFFFFFFF : 0xFFCCCCCC;
-        }
+    // cast the floor below the wall, and the ceiling above it on the mirrored rows
+    // (the wall is centered on the horizon, so wallTopPixel mirrors wallBottomPixel):
+    const float tangent = column_tangents[i];
+    castFloorColumn(
+        column,
+        stride,
+        wallBottomPixel > (WINDOW_HEIGHT / 2) ? wallBottomPixel : (WINDOW_HEIGHT / 2),
+        view->orientation.x - tangent * view->orientation.y,
+        view->orientation.y + tangent * view->orientation.x
+    );
+}
 
-        // set the color of the floor
-        for (int y = wallBottomPixel; y < WINDOW_HEIGHT; y++)
-            colorBuffer[(WINDOW_WIDTH * y) + i] = 0xFF777777;
+void projectTile(int tile) {
+    const int firstStrip = tile * COLUMN_TILE_WIDTH;
+    const int lastStrip = firstStrip + COLUMN_TILE_WIDTH < NUM_RAYS ? firstStrip + COLUMN_TILE_WIDTH : NUM_RAYS;
+    if (!isTileProjected(firstStrip, lastStrip))
+        return;
+    if (view->depthColumns) {
+        projectDepthTile(tile);
+        return;
+    }
+    const int hasSprites = view == &playerView && sprites.visibleCount > 0;
+    if (!isColumnMajorProjection) {
+        for (int i = firstStrip; i < lastStrip; i++)
+            projectColumn(i, &view->colorBuffer[i], WINDOW_WIDTH);
+        if (hasSprites)
+            drawSpriteTile(firstStrip, lastStrip, &view->colorBuffer[firstStrip], 1, WINDOW_WIDTH);
+        return;
     }
+
+    for (int i = firstStrip; i < lastStrip; i++)
+        projectColumn(i, &tileColumns[WINDOW_HEIGHT * (i - firstStrip)], 1);
+    if (hasSprites)
+        drawSpriteTile(firstStrip, lastStrip, tileColumns, WINDOW_HEIGHT, 1);
+    transposeTile(tileColumns, firstStrip, lastStrip - firstStrip);
+}
+
+void generate3DProjection() {
+    PROFILE_BEGIN(PROFILE_PROJECTION);
+    if (!coherence.isFrameSkipped) {
+        setFrameSprites();
+        runWorkers(projectTile, NUM_COLUMN_TILES);
+    }
+    PROFILE_END(PROFILE_PROJECTION);
+}
+
+void castAndProjectTile(int tile) {
+    castTile(tile);
+    projectTile(tile);
 }
 
-void clearColorBuffer(Uint32 color) {
-    for (int x = 0; x < WINDOW_WIDTH; x++)
-        for (int y = 0; y < WINDOW_HEIGHT; y++)
-            colorBuffer[(WINDOW_WIDTH * y) + x] = color;
+void castAndProjectAllRays() {
+    // Every tile is cast and filled by the same worker while its rays are still in cache,
+    // and runWorkers() only returns once all tiles are done (the frame barrier before renderColorBuffer):
+    PROFILE_BEGIN(PROFILE_CAST_AND_PROJECT);
+    setPlayerView();
+    beginCoherentFrame();
+    if (!coherence.isFrameSkipped) {
+        setFrameSprites();
+        runWorkers(castAndProjectTile, NUM_COLUMN_TILES);
+    }
+    PROFILE_END(PROFILE_CAST_AND_PROJECT);
 }
 
+#include "views.h"
+#include "replay.h"
+
+#ifdef HEADLESS
+#include "stream.h"
+#include "bench.h"
+#else
 void renderColorBuffer() {
+    PROFILE_BEGIN(PROFILE_RENDER_COLOR_BUFFER);
     SDL_UpdateTexture(
         colorBufferTexture,
         NULL,
@@ -615,36 +1114,119 @@ void renderColorBuffer() {
         (int)((Uint32)WINDOW_WIDTH * sizeof(Uint32))
     );
     SDL_RenderCopy(renderer, colorBufferTexture, NULL, NULL);
+    PROFILE_END(PROFILE_RENDER_COLOR_BUFFER);
 }
 
 void render() {
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     SDL_RenderClear(renderer);
 
-    generate3DProjection();
+    const long long start = clockNanoseconds(CLOCK_MONOTONIC);
+    castAndProjectAllRays();
+    resolution.lastFrameTime = clockNanoseconds(CLOCK_MONOTONIC) - start;
 
-    renderColorBuffer();
-    clearColorBuffer(0xFF000000);
+    // Every pixel of colorBuffer gets overwritten by the next frame's projection, so it's never cleared
+    // (and in depth-only mode, there are no pixels, only the minimap):
+    if (!playerView.depthColumns)
+        renderColorBuffer();
 
+    PROFILE_BEGIN(PROFILE_MINIMAP);
     renderMap();
     renderRays();
     renderPlayer();
+    PROFILE_END(PROFILE_MINIMAP);
 
+    PROFILE_BEGIN(PROFILE_PRESENT);
     SDL_RenderPresent(renderer);
+    PROFILE_END(PROFILE_PRESENT);
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    int isCoherent = TRUE;
+    int numSprites = 0;
+    int numDoors = 0;
+    int lowWallPercent = 0;
+    const char* recordingPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--uncapped"))
+            framePacing = FRAME_PACING_UNCAPPED;
+        else if (!strcmp(argv[i], "--vsync"))
+            framePacing = FRAME_PACING_VSYNC;
+        else if (!strcmp(argv[i], "--spin"))
+            framePacing = FRAME_PACING_SPIN;
+        else if (!strcmp(argv[i], "--fps") && i + 1 < argc)
+            framesPerSecond = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-coherence"))
+            isCoherent = FALSE;
+        else if (!strcmp(argv[i], "--ray-stride") && i + 1 < argc)
+            setRayStride(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--nearest-rays"))
+            camera.rayFill = RAY_FILL_NEAREST;
+        else if (!strcmp(argv[i], "--frame-budget") && i + 1 < argc)
+            startResolutionController(atof(argv[++i]));
+        else if (!strcmp(argv[i], "--depth-only"))
+            playerView.depthColumns = &playerDepthColumns;
+        else if (!strcmp(argv[i], "--sprites") && i + 1 < argc)
+            numSprites = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--doors") && i + 1 < argc)
+            numDoors = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--low-walls") && i + 1 < argc)
+            lowWallPercent = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--shading") && i + 1 < argc) {
+            if ((lighting.shading = parseShading(argv[++i])) < 0)
+                return 1;
+        }
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+            recordingPath = argv[++i];
+#ifdef PROFILE
+        else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+            openProfileTrace(argv[++i]);
+#endif
+        else if (argv[i][0] != '-') {
+            if (!loadMap(argv[i]))
+                return 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--fps N | --uncapped | --vsync | --spin] [--no-coherence]\n"
+                            "       [--ray-stride N] [--nearest-rays] [--frame-budget MS] [--depth-only]\n"
+                            "       [--sprites N] [--doors N] [--low-walls PERCENT] [--shading none|colormap|naive] [--record FILE] [--trace FILE (with PROFILE)] [MAP_FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
     isGameRunning = initializeWindow();
 
     setup();
+    coherence.isEnabled = isCoherent;
+    if (numSprites > 0 && !scatterSprites(numSprites, (unsigned int)time(NULL)))
+        isGameRunning = FALSE;
+    if (numDoors > 0 && !scatterDoors(numDoors, (unsigned int)time(NULL)))
+        isGameRunning = FALSE;
+    if (lowWallPercent > 0 && lowerWalls(lowWallPercent, (unsigned int)time(NULL)) < 0)
+        isGameRunning = FALSE;
+    if (recordingPath && !startRecording(recordingPath, (float)SIMULATION_TICK_LENGTH / NANOSECONDS_PER_SECOND))
+        isGameRunning = FALSE;
+    startScheduler(framePacing, framesPerSecond);
 
     while (isGameRunning) {
+        PROFILE_FRAME_BEGIN();
         processInput();
-        update();
+        const int ticks = update();
+        if (recording.file)
+            recordFrame(ticks);
         render();
+        PROFILE_FRAME_END(player.position.x, player.position.y);
+        waitForNextFrame();
     }
 
     destroyWindow();
+    freeSprites();
+    freeThinWalls();
+    if (recording.file)
+        stopRecording();
+    PROFILE_STOP();
+    if (coherence.isEnabled)
+        printCoherenceReport();
 
     return 0;
 }
+#endif
@@ -0,0 +1,335 @@
+// Map storage:
+// =========
+// The map's size is only known at runtime, independently of the window's resolution.
+// Cells are stored row-major, one MapCell each (0 for empty, otherwise the content of the wall).
+// Large maps are memory-mapped straight from a map file, laid out as a 16 byte header followed by the cells:
+//   "RMAP", number of columns, number of rows, bytes per cell (all 32 bit little-endian integers)
+// Walls can be lower than the ceiling: a map can have a height per cell (see heights.h), from 1 to
+// MAP_FULL_HEIGHT in map units, kept in an array of their own laid out like the cells, and only allocated once a
+// wall is lowered (so mapHeightAt() is MAP_FULL_HEIGHT for every cell until then). Map files with heights
+// have them after the cells, one byte per cell in the same order.
+//
+// Building with MAP_BLOCKED switches to a blocked backend instead: cells are stored in blocks of 8x8 cells,
+// so that a block fills exactly one 64 byte cache line and a ray crossing it touches one line instead of 8.
+// It also keeps one bit per block that's set when the block has no walls at all. The bits of a whole
+// 4096x4096 map take 32KB and stay in cache, so lookups in empty blocks never touch the cells themselves,
+// which lets traversal skip through empty regions of sparse maps without a cache miss per step.
+// Map files are always row-major, so loading a map with this backend copies it into blocks.
+//
+// Maps can be edited while running with setMapCell(). Every edit bumps map.version and is logged with the
+// region of cells it changed, so whatever is derived from the map (the block occupancy bits, the minimap
+// texture, the coherence cache) can be updated only where it changed: countMapEditsSince() tells how many
+// edits were made since the version it was derived from, and getMapEdit() what each of them changed. Once an
+// edit falls out of the log (or the whole map is replaced), the count is -1, and it has to be derived again.
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef uint8_t MapCell;
+typedef uint8_t MapHeight;
+
+#define MAP_FILE_MAGIC "RMAP"
+#define MAP_FILE_HEADER_SIZE 16
+#define MAP_EDIT_LOG_SIZE 256 // a power of 2
+#define MAP_FULL_HEIGHT TILE_SIZE // the height of walls reaching the ceiling
+
+#ifdef MAP_BLOCKED
+#define MAP_BLOCK_SHIFT 3
+#define MAP_BLOCK_SIZE (1 << MAP_BLOCK_SHIFT)
+#define MAP_BLOCK_MASK (MAP_BLOCK_SIZE - 1)
+#define MAP_BLOCK_CELLS (MAP_BLOCK_SIZE * MAP_BLOCK_SIZE)
+#endif
+
+struct Map {
+    int numRows;
+    int numCols;
+    int width;  // numCols * TILE_SIZE
+    int height; // numRows * TILE_SIZE
+    MapCell* cells;
+    MapHeight* heights; // of each cell, in the same layout, or NULL while every wall is of full height
+    void* mapping;
+    size_t mappingSize;
+    unsigned int version; // changes whenever the map does, so that anything derived from it can tell
+#ifdef MAP_BLOCKED
+    int numBlockCols;
+    int numBlockRows;
+    uint64_t* emptyBlocks;
+#endif
+} map;
+
+struct MapRegion {
+    int firstColumn;
+    int firstRow;
+    int lastColumn; // inclusive
+    int lastRow;    // inclusive
+};
+
+struct MapEditLog {
+    struct MapRegion regions[MAP_EDIT_LOG_SIZE]; // a ring, of the region of each version
+    unsigned int firstVersion; // the log has every edit made since this version
+} mapEdits;
+
+#ifdef MAP_BLOCKED
+size_t mapBlockAt(int column, int row) {
+    return (size_t)(row >> MAP_BLOCK_SHIFT) * map.numBlockCols + (column >> MAP_BLOCK_SHIFT);
+}
+
+MapCell* mapCellAt(int column, int row) {
+    return &map.cells[mapBlockAt(column, row) * MAP_BLOCK_CELLS + ((row & MAP_BLOCK_MASK) << MAP_BLOCK_SHIFT) + (column & MAP_BLOCK_MASK)];
+}
+
+int mapBlockIsEmpty(size_t block) {
+    return (int)((map.emptyBlocks[block >> 6] >> (block & 63)) & 1);
+}
+
+void updateMapBlockOccupancy(size_t block) {
+    const MapCell* cells = &map.cells[block * MAP_BLOCK_CELLS];
+    int isEmpty = TRUE;
+    for (int i = 0; i < MAP_BLOCK_CELLS; i++)
+        if (cells[i] != 0)
+            isEmpty = FALSE;
+
+    if (isEmpty)
+        map.emptyBlocks[block >> 6] |= 1ULL << (block & 63);
+    else
+        map.emptyBlocks[block >> 6] &= ~(1ULL << (block & 63));
+}
+
+int mapContentAt(int column, int row) {
+    if (mapBlockIsEmpty(mapBlockAt(column, row)))
+        return 0;
+
+    return *mapCellAt(column, row);
+}
+#else
+MapCell* mapCellAt(int column, int row) {
+    return &map.cells[(size_t)row * map.numCols + column];
+}
+
+int mapContentAt(int column, int row) {
+    return map.cells[(size_t)row * map.numCols + column];
+}
+#endif
+
+size_t mapStorageSize() {
+    // The number of cells the map's layout takes:
+#ifdef MAP_BLOCKED
+    return (size_t)map.numBlockCols * (size_t)map.numBlockRows * MAP_BLOCK_CELLS;
+#else
+    return (size_t)map.numCols * (size_t)map.numRows;
+#endif
+}
+
+int mapHeightAt(int column, int row) {
+    return map.heights ? map.heights[mapCellAt(column, row) - map.cells] : MAP_FULL_HEIGHT;
+}
+
+void unloadMap() {
+    if (map.mapping)
+        munmap(map.mapping, map.mappingSize);
+    else
+        free(map.cells);
+    free(map.heights);
+
+    map.cells = NULL;
+    map.heights = NULL;
+    map.mapping = NULL;
+    map.mappingSize = 0;
+#ifdef MAP_BLOCKED
+    free(map.emptyBlocks);
+    map.emptyBlocks = NULL;
+#endif
+}
+
+void setMapSize(int numCols, int numRows) {
+    map.version++;
+    mapEdits.firstVersion = map.version;
+    map.numCols = numCols;
+    map.numRows = numRows;
+    map.width = numCols * TILE_SIZE;
+    map.height = numRows * TILE_SIZE;
+}
+
+void setMapCells(const MapCell* cells) {
+    // Stores a copy of the given row-major cells in the map's own layout:
+#ifdef MAP_BLOCKED
+    map.numBlockCols = (map.numCols + MAP_BLOCK_MASK) >> MAP_BLOCK_SHIFT;
+    map.numBlockRows = (map.numRows + MAP_BLOCK_MASK) >> MAP_BLOCK_SHIFT;
+    const size_t numBlocks = (size_t)map.numBlockCols * (size_t)map.numBlockRows;
+
+    void* blocks = NULL;
+    if (posix_memalign(&blocks, MAP_BLOCK_CELLS * sizeof(MapCell), numBlocks * MAP_BLOCK_CELLS * sizeof(MapCell)) != 0)
+        blocks = NULL;
+    map.cells = (MapCell*)blocks;
+    map.emptyBlocks = (uint64_t*) calloc((numBlocks + 63) / 64, sizeof(uint64_t));
+    if (!map.cells || !map.emptyBlocks) {
+        fprintf(stderr, "Error allocating map blocks.\n");
+        exit(1);
+    }
+
+    // Cells of the blocks hanging over the map's right and bottom edges are left empty:
+    memset(map.cells, 0, numBlocks * MAP_BLOCK_CELLS * sizeof(MapCell));
+    for (int row = 0; row < map.numRows; row++)
+        for (int column = 0; column < map.numCols; column++)
+            *mapCellAt(column, row) = cells[(size_t)row * map.numCols + column];
+    for (size_t block = 0; block < numBlocks; block++)
+        updateMapBlockOccupancy(block);
+#else
+    const size_t size = sizeof(MapCell) * (size_t)map.numCols * (size_t)map.numRows;
+    map.cells = (MapCell*) malloc(size);
+    if (!map.cells) {
+        fprintf(stderr, "Error allocating map cells.\n");
+        exit(1);
+    }
+    memcpy(map.cells, cells, size);
+#endif
+}
+
+void setMap(int numCols, int numRows, const MapCell* cells) {
+    unloadMap();
+    setMapSize(numCols, numRows);
+    setMapCells(cells);
+}
+
+void markMapEdited(int firstColumn, int firstRow, int lastColumn, int lastRow) {
+    map.version++;
+    struct MapRegion* region = &mapEdits.regions[map.version & (MAP_EDIT_LOG_SIZE - 1)];
+    region->firstColumn = firstColumn;
+    region->firstRow = firstRow;
+    region->lastColumn = lastColumn;
+    region->lastRow = lastRow;
+    // (overwriting the region of the oldest version in the log)
+    if (map.version - mapEdits.firstVersion > MAP_EDIT_LOG_SIZE)
+        mapEdits.firstVersion = map.version - MAP_EDIT_LOG_SIZE;
+}
+
+void setMapCell(int column, int row, MapCell content) {
+    *mapCellAt(column, row) = content;
+#ifdef MAP_BLOCKED
+    updateMapBlockOccupancy(mapBlockAt(column, row));
+#endif
+    markMapEdited(column, row, column, row);
+}
+
+int allocateMapHeights() {
+    // Every wall of full height, to start with:
+    if (map.heights)
+        return TRUE;
+    map.heights = (MapHeight*) malloc(sizeof(MapHeight) * mapStorageSize());
+    if (!map.heights) {
+        fprintf(stderr, "Error allocating map heights.\n");
+        return FALSE;
+    }
+    memset(map.heights, MAP_FULL_HEIGHT, sizeof(MapHeight) * mapStorageSize());
+    return TRUE;
+}
+
+int setMapHeight(int column, int row, int height) {
+    // The height of a cell's wall, from 1 to MAP_FULL_HEIGHT:
+    if (height < 1 || height > MAP_FULL_HEIGHT) {
+        fprintf(stderr, "Error: wall heights go from 1 to %d, not %d.\n", MAP_FULL_HEIGHT, height);
+        return FALSE;
+    }
+    if (height == mapHeightAt(column, row))
+        return TRUE;
+    if (!allocateMapHeights())
+        return FALSE;
+    map.heights[mapCellAt(column, row) - map.cells] = (MapHeight)height;
+    markMapEdited(column, row, column, row);
+    return TRUE;
+}
+
+int countMapEditsSince(unsigned int version) {
+    // The number of edits since the given version, or -1 if the log doesn't go back that far:
+    if (version < mapEdits.firstVersion || version > map.version)
+        return -1;
+    return (int)(map.version - version);
+}
+
+const struct MapRegion* getMapEdit(int i) {
+    // The region of the i-th most recent edit:
+    return &mapEdits.regions[(map.version - (unsigned int)i) & (MAP_EDIT_LOG_SIZE - 1)];
+}
+
+int loadMap(const char* path) {
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        fprintf(stderr, "Error opening map file %s.\n", path);
+        return FALSE;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0 || (size_t)info.st_size < MAP_FILE_HEADER_SIZE) {
+        fprintf(stderr, "Error reading map file %s.\n", path);
+        close(file);
+        return FALSE;
+    }
+
+    // Mapped privately, so the cells can be edited in memory without ever touching the file:
+    void* mapping = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Error mapping map file %s.\n", path);
+        return FALSE;
+    }
+
+    uint32_t header[4];
+    memcpy(header, mapping, MAP_FILE_HEADER_SIZE);
+    const size_t numCells = (size_t)header[1] * (size_t)header[2];
+    if (memcmp(mapping, MAP_FILE_MAGIC, 4) != 0 ||
+        header[1] == 0 || header[2] == 0 || header[1] > INT_MAX / TILE_SIZE || header[2] > INT_MAX / TILE_SIZE ||
+        header[3] != sizeof(MapCell) ||
+        (size_t)info.st_size < MAP_FILE_HEADER_SIZE + numCells * sizeof(MapCell)) {
+        fprintf(stderr, "Error: %s is not a valid map file.\n", path);
+        munmap(mapping, (size_t)info.st_size);
+        return FALSE;
+    }
+
+    unloadMap();
+    setMapSize((int)header[1], (int)header[2]);
+    const MapHeight* heights = (size_t)info.st_size >= MAP_FILE_HEADER_SIZE + numCells * (sizeof(MapCell) + sizeof(MapHeight)) ?
+        (const MapHeight*)((char*)mapping + MAP_FILE_HEADER_SIZE + numCells * sizeof(MapCell)) : NULL;
+#ifdef MAP_BLOCKED
+    setMapCells((MapCell*)((char*)mapping + MAP_FILE_HEADER_SIZE));
+#else
+    map.cells = (MapCell*)((char*)mapping + MAP_FILE_HEADER_SIZE);
+#endif
+    // The heights are copied into the map's own layout (they're only read once per wall a ray hits):
+    int isLoaded = !heights || allocateMapHeights();
+    for (int row = 0; row < map.numRows && heights && isLoaded; row++)
+        for (int column = 0; column < map.numCols; column++)
+            map.heights[mapCellAt(column, row) - map.cells] = heights[(size_t)row * map.numCols + column];
+#ifdef MAP_BLOCKED
+    munmap(mapping, (size_t)info.st_size);
+#else
+    map.mapping = mapping;
+    map.mappingSize = (size_t)info.st_size;
+#endif
+
+    return isLoaded;
+}
+
+int saveMap(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error creating map file %s.\n", path);
+        return FALSE;
+    }
+    uint32_t header[4] = {0, (uint32_t)map.numCols, (uint32_t)map.numRows, sizeof(MapCell)};
+    memcpy(header, MAP_FILE_MAGIC, 4);
+
+    int saved = fwrite(header, MAP_FILE_HEADER_SIZE, 1, file) == 1;
+    for (int row = 0; row < map.numRows && saved; row++)
+        for (int column = 0; column < map.numCols && saved; column++)
+            saved = fwrite(mapCellAt(column, row), sizeof(MapCell), 1, file) == 1;
+    for (int row = 0; row < map.numRows && saved && map.heights; row++)
+        for (int column = 0; column < map.numCols && saved; column++)
+            saved = fwrite(&map.heights[mapCellAt(column, row) - map.cells], sizeof(MapHeight), 1, file) == 1;
+    if (fclose(file) != 0 || !saved) {
+        fprintf(stderr, "Error writing map file %s.\n", path);
+        return FALSE;
+    }
+    return TRUE;
+}
+// =========
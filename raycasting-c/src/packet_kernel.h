@@ -0,0 +1,179 @@
+// Packet ray casting kernel body:
+// =========
+// Included by packets.h once per instruction set, with the PACKET_* macros describing the lanes.
+// Mirrors castRay() operation for operation, so every lane produces the exact same hit as the scalar kernel.
+// Lanes that hit a wall (or leave the map) are masked out of the march, which ends once no lane is active.
+
+// Looks up the map cells of the active lanes, returning the lanes that hit a wall (as mapHasWallAt() would)
+// and storing their wall content:
+PACKET_TARGET int PACKET_WALL_LANES(PACKET_FLOAT xToCheck, PACKET_FLOAT yToCheck, int activeLanes, int* content) {
+    const PACKET_FLOAT zero = PACKET_SET1(0);
+    const PACKET_FLOAT inverseTile = PACKET_SET1(1.0f / TILE_SIZE);
+    const PACKET_FLOAT outside = PACKET_OR(
+        PACKET_OR(PACKET_CMPLT(xToCheck, zero), PACKET_CMPGE(xToCheck, PACKET_SET1(map.width))),
+        PACKET_OR(PACKET_CMPLT(yToCheck, zero), PACKET_CMPGE(yToCheck, PACKET_SET1(map.height)))
+    );
+    // Coordinates inside the map are never negative, so truncation is the same as floor():
+    int columns[PACKET_WIDTH], rows[PACKET_WIDTH];
+    PACKET_STORE_INT(columns, PACKET_MUL(xToCheck, inverseTile));
+    PACKET_STORE_INT(rows, PACKET_MUL(yToCheck, inverseTile));
+
+    int hitLanes = PACKET_MOVEMASK(outside) & activeLanes;
+    PROFILE_COUNT(wallChecks, __builtin_popcount(activeLanes));
+    for (int lane = 0; lane < PACKET_WIDTH; lane++) {
+        if (!((activeLanes >> lane) & 1))
+            continue;
+        if ((hitLanes >> lane) & 1) {
+            content[lane] = 0;
+            continue;
+        }
+        content[lane] = mapContentAt(columns[lane], rows[lane]);
+        if (content[lane] != 0)
+            hitLanes |= 1 << lane;
+    }
+    return hitLanes;
+}
+
+PACKET_TARGET void PACKET_FUNCTION(vec2* directions, int firstStrip) {
+    PROFILE_COUNT(rays, PACKET_WIDTH);
+    float lanes[PACKET_WIDTH];
+    int horzWallContent[PACKET_WIDTH];
+    int vertWallContent[PACKET_WIDTH];
+
+    for (int lane = 0; lane < PACKET_WIDTH; lane++) lanes[lane] = directions[lane].x;
+    const PACKET_FLOAT dx = PACKET_LOAD(lanes);
+    for (int lane = 0; lane < PACKET_WIDTH; lane++) lanes[lane] = directions[lane].y;
+    const PACKET_FLOAT dy = PACKET_LOAD(lanes);
+
+    const PACKET_FLOAT zero = PACKET_SET1(0);
+    const PACKET_FLOAT tile = PACKET_SET1(TILE_SIZE);
+    const PACKET_FLOAT signBit = PACKET_SET1(-0.0f);
+    const PACKET_FLOAT width = PACKET_SET1(map.width);
+    const PACKET_FLOAT height = PACKET_SET1(map.height);
+    const PACKET_FLOAT px = PACKET_SET1(view->position.x);
+    const PACKET_FLOAT py = PACKET_SET1(view->position.y);
+
+    const PACKET_FLOAT isRayFacingDown = PACKET_CMPGT(dy, zero);
+    const PACKET_FLOAT isRayFacingRight = PACKET_CMPGT(dx, zero);
+
+    PACKET_FLOAT xintercept, yintercept;
+    PACKET_FLOAT xstep, ystep;
+    PACKET_FLOAT x, y, xToCheck, yToCheck, active, hit;
+
+    ///////////////////////////////////////////
+    // HORIZONTAL RAY-GRID INTERSECTION CODE
+    ///////////////////////////////////////////
+    PACKET_FLOAT foundHorzWallHit = zero;
+    PACKET_FLOAT horzWallHitX = zero;
+    PACKET_FLOAT horzWallHitY = zero;
+
+    yintercept = PACKET_SET1(floor(view->position.y / TILE_SIZE) * TILE_SIZE);
+    yintercept = PACKET_ADD(yintercept, PACKET_AND(isRayFacingDown, tile));
+    const PACKET_FLOAT xPerY = PACKET_LOAD(&view->raySlopes->xPerY[firstStrip]);
+    xintercept = PACKET_ADD(px, PACKET_MUL(PACKET_SUB(yintercept, py), xPerY));
+
+    xstep = PACKET_MUL(tile, xPerY);
+    xstep = PACKET_XOR(xstep, PACKET_AND(signBit, PACKET_OR(
+        PACKET_ANDNOT(isRayFacingRight, PACKET_CMPGT(xstep, zero)),
+        PACKET_AND(isRayFacingRight, PACKET_CMPLT(xstep, zero))
+    )));
+    ystep = PACKET_OR(PACKET_AND(isRayFacingDown, tile), PACKET_ANDNOT(isRayFacingDown, PACKET_SET1(-TILE_SIZE)));
+
+    x = xintercept;
+    y = yintercept;
+    active = PACKET_CMPEQ(zero, zero);
+    for (;;) {
+        active = PACKET_AND(active, PACKET_AND(
+            PACKET_AND(PACKET_CMPGE(x, zero), PACKET_CMPLE(x, width)),
+            PACKET_AND(PACKET_CMPGE(y, zero), PACKET_CMPLE(y, height))
+        ));
+        int activeLanes = PACKET_MOVEMASK(active);
+        if (!activeLanes)
+            break;
+
+        xToCheck = x;
+        yToCheck = PACKET_ADD(y, PACKET_ANDNOT(isRayFacingDown, PACKET_SET1(-1)));
+        PROFILE_COUNT(horizontalSteps, __builtin_popcount(activeLanes));
+        int hitLanes = PACKET_WALL_LANES(xToCheck, yToCheck, activeLanes, horzWallContent);
+
+        hit = PACKET_AND(active, PACKET_LANE_MASK(hitLanes));
+        horzWallHitX = PACKET_BLEND(hit, x, horzWallHitX);
+        horzWallHitY = PACKET_BLEND(hit, y, horzWallHitY);
+        foundHorzWallHit = PACKET_OR(foundHorzWallHit, hit);
+        active = PACKET_ANDNOT(hit, active);
+
+        x = PACKET_ADD(x, xstep);
+        y = PACKET_ADD(y, ystep);
+    }
+
+    ///////////////////////////////////////////
+    // VERTICAL RAY-GRID INTERSECTION CODE
+    ///////////////////////////////////////////
+    PACKET_FLOAT foundVertWallHit = zero;
+    PACKET_FLOAT vertWallHitX = zero;
+    PACKET_FLOAT vertWallHitY = zero;
+
+    xintercept = PACKET_SET1(floor(view->position.x / TILE_SIZE) * TILE_SIZE);
+    xintercept = PACKET_ADD(xintercept, PACKET_AND(isRayFacingRight, tile));
+    const PACKET_FLOAT yPerX = PACKET_LOAD(&view->raySlopes->yPerX[firstStrip]);
+    yintercept = PACKET_ADD(py, PACKET_MUL(PACKET_SUB(xintercept, px), yPerX));
+
+    ystep = PACKET_MUL(tile, yPerX);
+    ystep = PACKET_XOR(ystep, PACKET_AND(signBit, PACKET_OR(
+        PACKET_ANDNOT(isRayFacingDown, PACKET_CMPGT(ystep, zero)),
+        PACKET_AND(isRayFacingDown, PACKET_CMPLT(ystep, zero))
+    )));
+    xstep = PACKET_OR(PACKET_AND(isRayFacingRight, tile), PACKET_ANDNOT(isRayFacingRight, PACKET_SET1(-TILE_SIZE)));
+
+    x = xintercept;
+    y = yintercept;
+    active = PACKET_CMPEQ(zero, zero);
+    for (;;) {
+        active = PACKET_AND(active, PACKET_AND(
+            PACKET_AND(PACKET_CMPGE(x, zero), PACKET_CMPLE(x, width)),
+            PACKET_AND(PACKET_CMPGE(y, zero), PACKET_CMPLE(y, height))
+        ));
+        int activeLanes = PACKET_MOVEMASK(active);
+        if (!activeLanes)
+            break;
+
+        xToCheck = PACKET_ADD(x, PACKET_ANDNOT(isRayFacingRight, PACKET_SET1(-1)));
+        yToCheck = y;
+        PROFILE_COUNT(verticalSteps, __builtin_popcount(activeLanes));
+        int hitLanes = PACKET_WALL_LANES(xToCheck, yToCheck, activeLanes, vertWallContent);
+
+        hit = PACKET_AND(active, PACKET_LANE_MASK(hitLanes));
+        vertWallHitX = PACKET_BLEND(hit, x, vertWallHitX);
+        vertWallHitY = PACKET_BLEND(hit, y, vertWallHitY);
+        foundVertWallHit = PACKET_OR(foundVertWallHit, hit);
+        active = PACKET_ANDNOT(hit, active);
+
+        x = PACKET_ADD(x, xstep);
+        y = PACKET_ADD(y, ystep);
+    }
+
+    // Calculate both horizontal and vertical squared hit distances and choose the smallest one
+    const PACKET_FLOAT noHit = PACKET_SET1(FLT_MAX);
+    PACKET_FLOAT horzX = PACKET_SUB(horzWallHitX, px);
+    PACKET_FLOAT horzY = PACKET_SUB(horzWallHitY, py);
+    PACKET_FLOAT vertX = PACKET_SUB(vertWallHitX, px);
+    PACKET_FLOAT vertY = PACKET_SUB(vertWallHitY, py);
+    PACKET_FLOAT horzHitDistance = PACKET_BLEND(foundHorzWallHit, PACKET_ADD(PACKET_MUL(horzX, horzX), PACKET_MUL(horzY, horzY)), noHit);
+    PACKET_FLOAT vertHitDistance = PACKET_BLEND(foundVertWallHit, PACKET_ADD(PACKET_MUL(vertX, vertX), PACKET_MUL(vertY, vertY)), noHit);
+    const int vertLanes = PACKET_MOVEMASK(PACKET_CMPLT(vertHitDistance, horzHitDistance));
+
+    float wallHitX[PACKET_WIDTH], wallHitY[PACKET_WIDTH];
+    const PACKET_FLOAT isVert = PACKET_LANE_MASK(vertLanes);
+    PACKET_STORE(wallHitX, PACKET_BLEND(isVert, vertWallHitX, horzWallHitX));
+    PACKET_STORE(wallHitY, PACKET_BLEND(isVert, vertWallHitY, horzWallHitY));
+
+    for (int lane = 0; lane < PACKET_WIDTH; lane++) {
+        struct Ray* ray = &view->rays[firstStrip + lane];
+        const int wasHitVertical = (vertLanes >> lane) & 1;
+        ray->wallHit.x = wallHitX[lane];
+        ray->wallHit.y = wallHitY[lane];
+        ray->wallHitContent = wasHitVertical ? vertWallContent[lane] : horzWallContent[lane];
+        ray->wasHitVertical = wasHitVertical;
+        ray->direction = directions[lane];
+    }
+}
@@ -0,0 +1,151 @@
+// Packet ray casting:
+// =========
+// Casts 4 (SSE2) or 8 (AVX2) adjacent rays at once, one per SIMD lane.
+// The widest instruction set supported by the running CPU is picked at startup,
+// falling back to the scalar castRay() on CPUs (or architectures) without either.
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PACKET_SIMD
+#endif
+
+typedef void (*PacketKernel)(vec2* directions, int firstStrip);
+
+int maxPacketWidth = 8;
+int packetWidth = 1;
+PacketKernel castRayPacket = NULL;
+const char* packetKernelName = "scalar";
+
+#ifdef PACKET_SIMD
+#define PACKET_WIDTH 4
+#define PACKET_TARGET __attribute__((target("sse2")))
+#define PACKET_FUNCTION castRayPacketSSE2
+#define PACKET_WALL_LANES wallLanesSSE2
+#define PACKET_FLOAT __m128
+#define PACKET_LOAD(p) _mm_loadu_ps(p)
+#define PACKET_STORE(p, v) _mm_storeu_ps(p, v)
+#define PACKET_STORE_INT(p, v) _mm_storeu_si128((__m128i*)(p), _mm_cvttps_epi32(v))
+#define PACKET_SET1(f) _mm_set1_ps(f)
+#define PACKET_ADD(a, b) _mm_add_ps(a, b)
+#define PACKET_SUB(a, b) _mm_sub_ps(a, b)
+#define PACKET_MUL(a, b) _mm_mul_ps(a, b)
+#define PACKET_AND(a, b) _mm_and_ps(a, b)
+#define PACKET_OR(a, b) _mm_or_ps(a, b)
+#define PACKET_XOR(a, b) _mm_xor_ps(a, b)
+#define PACKET_ANDNOT(a, b) _mm_andnot_ps(a, b)
+#define PACKET_BLEND(mask, a, b) _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b))
+#define PACKET_CMPEQ(a, b) _mm_cmpeq_ps(a, b)
+#define PACKET_CMPGT(a, b) _mm_cmpgt_ps(a, b)
+#define PACKET_CMPGE(a, b) _mm_cmpge_ps(a, b)
+#define PACKET_CMPLT(a, b) _mm_cmplt_ps(a, b)
+#define PACKET_CMPLE(a, b) _mm_cmple_ps(a, b)
+#define PACKET_MOVEMASK(v) _mm_movemask_ps(v)
+#define PACKET_LANE_MASK(bits) _mm_castsi128_ps(_mm_cmpeq_epi32( \
+    _mm_and_si128(_mm_set1_epi32(bits), _mm_setr_epi32(1, 2, 4, 8)), _mm_setr_epi32(1, 2, 4, 8)))
+#include "packet_kernel.h"
+#undef PACKET_WIDTH
+#undef PACKET_TARGET
+#undef PACKET_FUNCTION
+#undef PACKET_WALL_LANES
+#undef PACKET_FLOAT
+#undef PACKET_LOAD
+#undef PACKET_STORE
+#undef PACKET_STORE_INT
+#undef PACKET_SET1
+#undef PACKET_ADD
+#undef PACKET_SUB
+#undef PACKET_MUL
+#undef PACKET_AND
+#undef PACKET_OR
+#undef PACKET_XOR
+#undef PACKET_ANDNOT
+#undef PACKET_BLEND
+#undef PACKET_CMPEQ
+#undef PACKET_CMPGT
+#undef PACKET_CMPGE
+#undef PACKET_CMPLT
+#undef PACKET_CMPLE
+#undef PACKET_MOVEMASK
+#undef PACKET_LANE_MASK
+
+#define PACKET_WIDTH 8
+#define PACKET_TARGET __attribute__((target("avx2")))
+#define PACKET_FUNCTION castRayPacketAVX2
+#define PACKET_WALL_LANES wallLanesAVX2
+#define PACKET_FLOAT __m256
+#define PACKET_LOAD(p) _mm256_loadu_ps(p)
+#define PACKET_STORE(p, v) _mm256_storeu_ps(p, v)
+#define PACKET_STORE_INT(p, v) _mm256_storeu_si256((__m256i*)(p), _mm256_cvttps_epi32(v))
+#define PACKET_SET1(f) _mm256_set1_ps(f)
+#define PACKET_ADD(a, b) _mm256_add_ps(a, b)
+#define PACKET_SUB(a, b) _mm256_sub_ps(a, b)
+#define PACKET_MUL(a, b) _mm256_mul_ps(a, b)
+#define PACKET_AND(a, b) _mm256_and_ps(a, b)
+#define PACKET_OR(a, b) _mm256_or_ps(a, b)
+#define PACKET_XOR(a, b) _mm256_xor_ps(a, b)
+#define PACKET_ANDNOT(a, b) _mm256_andnot_ps(a, b)
+#define PACKET_BLEND(mask, a, b) _mm256_blendv_ps(b, a, mask)
+#define PACKET_CMPEQ(a, b) _mm256_cmp_ps(a, b, _CMP_EQ_OQ)
+#define PACKET_CMPGT(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define PACKET_CMPGE(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define PACKET_CMPLT(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define PACKET_CMPLE(a, b) _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+#define PACKET_MOVEMASK(v) _mm256_movemask_ps(v)
+#define PACKET_LANE_MASK(bits) _mm256_castsi256_ps(_mm256_cmpeq_epi32( \
+    _mm256_and_si256(_mm256_set1_epi32(bits), _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128)), \
+    _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128)))
+#include "packet_kernel.h"
+#undef PACKET_WIDTH
+#undef PACKET_TARGET
+#undef PACKET_FUNCTION
+#undef PACKET_WALL_LANES
+#undef PACKET_FLOAT
+#undef PACKET_LOAD
+#undef PACKET_STORE
+#undef PACKET_STORE_INT
+#undef PACKET_SET1
+#undef PACKET_ADD
+#undef PACKET_SUB
+#undef PACKET_MUL
+#undef PACKET_AND
+#undef PACKET_OR
+#undef PACKET_XOR
+#undef PACKET_ANDNOT
+#undef PACKET_BLEND
+#undef PACKET_CMPEQ
+#undef PACKET_CMPGT
+#undef PACKET_CMPGE
+#undef PACKET_CMPLT
+#undef PACKET_CMPLE
+#undef PACKET_MOVEMASK
+#undef PACKET_LANE_MASK
+#endif
+
+void selectPacketKernel(int maxWidth) {
+    // Picks the widest packet kernel the CPU supports, up to maxWidth lanes (1 for the scalar kernel):
+    packetWidth = 1;
+    castRayPacket = NULL;
+    packetKernelName = "scalar";
+#ifdef RAY_KERNEL_DDA
+    // The packet kernels mirror castRay(), so they're not used with the grid traversal kernel:
+    packetKernelName = "dda";
+    return;
+#endif
+#ifdef RAY_KERNEL_FIXED
+    // Nor with the fixed-point kernel, which casts whole tiles itself:
+    packetKernelName = "fixed";
+    return;
+#endif
+#ifdef PACKET_SIMD
+    __builtin_cpu_init();
+    if (maxWidth >= 8 && __builtin_cpu_supports("avx2")) {
+        packetWidth = 8;
+        castRayPacket = castRayPacketAVX2;
+        packetKernelName = "avx2";
+    } else if (maxWidth >= 4 && __builtin_cpu_supports("sse2")) {
+        packetWidth = 4;
+        castRayPacket = castRayPacketSSE2;
+        packetKernelName = "sse2";
+    }
+#endif
+}
+// =========
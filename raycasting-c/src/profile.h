@@ -0,0 +1,228 @@
+// Hot-path instrumentation:
+// =========
+// Building with PROFILE (e.g: make DEFINES=-DPROFILE, or make headless DEFINES=-DPROFILE) times the stages of
+// each frame on the main thread with the monotonic clock, and counts what the ray casting kernels do on every
+// thread: rays cast, grid steps taken on the horizontal and the vertical grid lines, and map lookups for walls
+// (mapHasWallAt() and its equivalents in the other kernels). Without PROFILE, the PROFILE_* macros compile to
+// nothing at all.
+// A summary of the stages and counters is printed every PROFILE_REPORT_LENGTH, along with the frame that took
+// the most steps per ray and where the player stood. With --trace FILE, every stage of every frame is also
+// written to FILE as Chrome trace events (to open in chrome://tracing or ui.perfetto.dev), along with the
+// counters of each frame, and the player's position on the frame's own event, so slow frames can be traced
+// back to the viewpoint that caused them.
+// Counters are per thread (so counting costs an add, not an atomic), and summed by the main thread at the end
+// of each frame, when the workers are parked.
+#ifdef PROFILE
+#include <stdarg.h>
+#include <string.h>
+
+#define PROFILE_REPORT_LENGTH (5 * NANOSECONDS_PER_SECOND)
+#define MAX_PROFILE_THREADS 64 // as MAX_WORKERS
+
+enum ProfileZone {
+    PROFILE_PROCESS_INPUT,
+    PROFILE_MOVE_PLAYER,
+    PROFILE_CAST_ALL_RAYS,
+    PROFILE_PROJECTION,
+    PROFILE_CAST_AND_PROJECT,
+    PROFILE_SPRITES,
+    PROFILE_RENDER_COLOR_BUFFER,
+    PROFILE_MINIMAP,
+    PROFILE_PRESENT,
+    PROFILE_FRAME,
+    PROFILE_ZONE_COUNT
+};
+const char* profileZoneNames[PROFILE_ZONE_COUNT] = {
+    "processInput",
+    "movePlayer",
+    "castAllRays",
+    "generate3DProjection",
+    "castAndProjectAllRays",
+    "setVisibleSprites",
+    "renderColorBuffer",
+    "minimap",
+    "SDL_RenderPresent",
+    "frame"
+};
+
+struct ProfileCounters {
+    long long rays;
+    long long horizontalSteps;
+    long long verticalSteps;
+    long long wallChecks;
+};
+
+struct Profile {
+    long long zoneStarts[PROFILE_ZONE_COUNT];
+    long long clockStart; // of the trace's timestamps
+    FILE* trace;
+    int traceEvents;
+
+    // Every thread's counters, registered once per thread:
+    struct ProfileCounters* threadCounters[MAX_PROFILE_THREADS];
+    int threads;
+
+    // Totals of the current report window:
+    long long reportLength;
+    long long windowStart;
+    int frames;
+    long long zoneTimes[PROFILE_ZONE_COUNT];
+    long long zoneMaxTimes[PROFILE_ZONE_COUNT];
+    long long zoneFrameTimes[PROFILE_ZONE_COUNT]; // of the current frame, since zones can run more than once
+    struct ProfileCounters counters;
+    double worstStepsPerRay;
+    float worstX, worstY;
+} profile;
+
+__thread struct ProfileCounters profileCounters;
+
+void registerProfileThread() {
+    const int thread = __sync_fetch_and_add(&profile.threads, 1);
+    if (thread < MAX_PROFILE_THREADS)
+        profile.threadCounters[thread] = &profileCounters;
+}
+
+void openProfileTrace(const char* path) {
+    profile.trace = fopen(path, "w");
+    if (!profile.trace) {
+        fprintf(stderr, "Error opening the trace file %s.\n", path);
+        exit(1);
+    }
+    fprintf(profile.trace, "{\"traceEvents\":[\n");
+}
+
+void writeTraceEvent(const char* format, ...) {
+    // An event object, separated from the previous one:
+    va_list args;
+    va_start(args, format);
+    fputs(profile.traceEvents++ ? ",\n" : "", profile.trace);
+    vfprintf(profile.trace, format, args);
+    va_end(args);
+}
+
+void resetProfileWindow(long long now) {
+    profile.windowStart = now;
+    profile.frames = 0;
+    memset(profile.zoneTimes, 0, sizeof(profile.zoneTimes));
+    memset(profile.zoneMaxTimes, 0, sizeof(profile.zoneMaxTimes));
+    memset(&profile.counters, 0, sizeof(profile.counters));
+    profile.worstStepsPerRay = 0;
+}
+
+void startProfile() {
+    // On the main thread, before the workers start:
+    const long long now = clockNanoseconds(CLOCK_MONOTONIC);
+    profile.clockStart = now;
+    profile.reportLength = PROFILE_REPORT_LENGTH;
+    registerProfileThread();
+    resetProfileWindow(now);
+}
+
+void beginProfileZone(int zone) {
+    profile.zoneStarts[zone] = clockNanoseconds(CLOCK_MONOTONIC);
+}
+
+void endProfileZone(int zone) {
+    const long long end = clockNanoseconds(CLOCK_MONOTONIC);
+    const long long time = end - profile.zoneStarts[zone];
+    profile.zoneFrameTimes[zone] += time;
+    if (profile.trace && zone != PROFILE_FRAME)
+        writeTraceEvent("{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+            profileZoneNames[zone], (profile.zoneStarts[zone] - profile.clockStart) / 1e3, time / 1e3);
+}
+
+void printProfileReport(long long now) {
+    const double seconds = (double)(now - profile.windowStart) / NANOSECONDS_PER_SECOND;
+    const int frames = profile.frames > 0 ? profile.frames : 1;
+    const double rays = profile.counters.rays > 0 ? (double)profile.counters.rays : 1;
+    printf("profile: %d frames in %.1fs\n", profile.frames, seconds);
+    for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++)
+        if (profile.zoneMaxTimes[zone] > 0)
+            printf("  %-24s %9.3fms mean %9.3fms max\n",
+                profileZoneNames[zone], profile.zoneTimes[zone] / 1e6 / frames, profile.zoneMaxTimes[zone] / 1e6);
+    printf("  rays: %.0f/frame, steps per ray: %.2f horizontal, %.2f vertical, wall checks: %.0f/frame\n",
+        profile.counters.rays / (double)frames, profile.counters.horizontalSteps / rays,
+        profile.counters.verticalSteps / rays, profile.counters.wallChecks / (double)frames);
+    if (profile.worstStepsPerRay > 0)
+        printf("  most steps per ray: %.2f, at (%.1f, %.1f)\n", profile.worstStepsPerRay, profile.worstX, profile.worstY);
+}
+
+void endProfileFrame(float x, float y) {
+    // Sums up the counters of every thread, which are parked until the next frame:
+    endProfileZone(PROFILE_FRAME);
+    struct ProfileCounters frame = {0, 0, 0, 0};
+    const int threads = profile.threads < MAX_PROFILE_THREADS ? profile.threads : MAX_PROFILE_THREADS;
+    for (int i = 0; i < threads; i++) {
+        struct ProfileCounters* counters = profile.threadCounters[i];
+        frame.rays += counters->rays;
+        frame.horizontalSteps += counters->horizontalSteps;
+        frame.verticalSteps += counters->verticalSteps;
+        frame.wallChecks += counters->wallChecks;
+        memset(counters, 0, sizeof(*counters));
+    }
+    const double stepsPerRay = frame.rays > 0 ? (double)(frame.horizontalSteps + frame.verticalSteps) / frame.rays : 0;
+
+    if (profile.trace) {
+        const long long start = profile.zoneStarts[PROFILE_FRAME] - profile.clockStart;
+        writeTraceEvent("{\"name\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,"
+            "\"args\":{\"x\":%.2f,\"y\":%.2f,\"rays\":%lld,\"stepsPerRay\":%.2f}}",
+            start / 1e3, profile.zoneFrameTimes[PROFILE_FRAME] / 1e3, x, y, frame.rays, stepsPerRay);
+        writeTraceEvent("{\"name\":\"steps\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,"
+            "\"args\":{\"horizontal\":%lld,\"vertical\":%lld,\"wallChecks\":%lld}}",
+            start / 1e3, frame.horizontalSteps, frame.verticalSteps, frame.wallChecks);
+    }
+
+    profile.frames++;
+    profile.counters.rays += frame.rays;
+    profile.counters.horizontalSteps += frame.horizontalSteps;
+    profile.counters.verticalSteps += frame.verticalSteps;
+    profile.counters.wallChecks += frame.wallChecks;
+    if (stepsPerRay > profile.worstStepsPerRay) {
+        profile.worstStepsPerRay = stepsPerRay;
+        profile.worstX = x;
+        profile.worstY = y;
+    }
+    for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+        profile.zoneTimes[zone] += profile.zoneFrameTimes[zone];
+        if (profile.zoneFrameTimes[zone] > profile.zoneMaxTimes[zone])
+            profile.zoneMaxTimes[zone] = profile.zoneFrameTimes[zone];
+        profile.zoneFrameTimes[zone] = 0;
+    }
+
+    const long long now = clockNanoseconds(CLOCK_MONOTONIC);
+    if (now - profile.windowStart >= profile.reportLength) {
+        printProfileReport(now);
+        resetProfileWindow(now);
+    }
+}
+
+void stopProfile() {
+    // Reports what's left of the last window, and closes the trace:
+    if (profile.frames > 0)
+        printProfileReport(clockNanoseconds(CLOCK_MONOTONIC));
+    if (profile.trace) {
+        fprintf(profile.trace, "\n]}\n");
+        fclose(profile.trace);
+        profile.trace = NULL;
+    }
+}
+
+#define PROFILE_START() startProfile()
+#define PROFILE_STOP() stopProfile()
+#define PROFILE_THREAD() registerProfileThread()
+#define PROFILE_BEGIN(zone) beginProfileZone(zone)
+#define PROFILE_END(zone) endProfileZone(zone)
+#define PROFILE_FRAME_BEGIN() beginProfileZone(PROFILE_FRAME)
+#define PROFILE_FRAME_END(x, y) endProfileFrame(x, y)
+#define PROFILE_COUNT(counter, amount) (profileCounters.counter += (amount))
+#else
+#define PROFILE_START()
+#define PROFILE_STOP()
+#define PROFILE_THREAD()
+#define PROFILE_BEGIN(zone)
+#define PROFILE_END(zone)
+#define PROFILE_FRAME_BEGIN()
+#define PROFILE_FRAME_END(x, y)
+#define PROFILE_COUNT(counter, amount)
+#endif
+// =========
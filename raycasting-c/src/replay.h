@@ -0,0 +1,129 @@
+// Input recording and replay:
+// =========
+// The player's movement only depends on the input of each frame and the ticks the simulation ran in it, so a
+// recording of those replays a session exactly, frame for frame, without a window (see the bench's --replay),
+// to check that the frames didn't change against golden hashes, or as a repeatable workload.
+// A recording file is a 32 byte header followed by one byte per frame:
+//   "RREC", version, tick length, number of frames, map columns, map rows, map checksum, flags (all 32 bit
+//   little-endian integers, but the tick length, which is the float deltaTime passed to tickSimulation())
+// and then per frame: its ticks (bits 0-3), walkDirection + 1 (bits 4-5) and turnDirection + 1 (bits 6-7)
+// Replaying checks that the map is the same one (by size and checksum) and turns the coherence cache on or off
+// as recorded, since it changes how the player turns (see turnByRaySteps()). The images also depend on the
+// options they're rendered with (ray stride, kernel...), which aren't recorded.
+#define RECORDING_MAGIC "RREC"
+#define RECORDING_VERSION 1
+#define RECORDING_HEADER_SIZE 32
+#define RECORDING_COHERENT 1 // flag
+
+struct Recording {
+    FILE* file; // while recording
+    float tickLength; // seconds
+    int frames;
+    unsigned char* inputs; // when replaying
+    uint32_t flags;
+} recording;
+
+uint32_t mapChecksum() {
+    // FNV-1a over every cell, row by row:
+    uint32_t hash = 2166136261u;
+    for (int row = 0; row < map.numRows; row++)
+        for (int column = 0; column < map.numCols; column++) {
+            hash ^= *mapCellAt(column, row);
+            hash *= 16777619u;
+        }
+    return hash;
+}
+
+void setRecordingHeader(uint32_t* header) {
+    memcpy(header, RECORDING_MAGIC, 4);
+    header[1] = RECORDING_VERSION;
+    memcpy(&header[2], &recording.tickLength, sizeof(float));
+    header[3] = (uint32_t)recording.frames;
+    header[4] = (uint32_t)map.numCols;
+    header[5] = (uint32_t)map.numRows;
+    header[6] = mapChecksum();
+    header[7] = recording.flags;
+}
+
+int startRecording(const char* path, float tickLength) {
+    // After setup(), once the map is loaded (the header is written again with the number of frames at the end):
+    uint32_t header[RECORDING_HEADER_SIZE / 4];
+    recording.file = fopen(path, "wb");
+    recording.tickLength = tickLength;
+    recording.frames = 0;
+    recording.flags = coherence.isEnabled ? RECORDING_COHERENT : 0;
+    setRecordingHeader(header);
+    if (!recording.file || fwrite(header, RECORDING_HEADER_SIZE, 1, recording.file) != 1) {
+        fprintf(stderr, "Error creating recording file %s.\n", path);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void recordFrame(int ticks) {
+    const unsigned char input = (unsigned char)(ticks | ((player.walkDirection + 1) << 4) | ((player.turnDirection + 1) << 6));
+    fputc(input, recording.file);
+    recording.frames++;
+}
+
+int stopRecording() {
+    uint32_t header[RECORDING_HEADER_SIZE / 4];
+    setRecordingHeader(header);
+    int saved = fseek(recording.file, 0, SEEK_SET) == 0 && fwrite(header, RECORDING_HEADER_SIZE, 1, recording.file) == 1;
+    if (fclose(recording.file) != 0 || !saved) {
+        fprintf(stderr, "Error writing the recording.\n");
+        saved = FALSE;
+    }
+    recording.file = NULL;
+    return saved;
+}
+
+int loadRecording(const char* path) {
+    // After setup(), to check it against the map:
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error opening recording file %s.\n", path);
+        return FALSE;
+    }
+    uint32_t header[RECORDING_HEADER_SIZE / 4];
+    if (fread(header, RECORDING_HEADER_SIZE, 1, file) != 1 || memcmp(header, RECORDING_MAGIC, 4) != 0 ||
+        header[1] != RECORDING_VERSION) {
+        fprintf(stderr, "Error: %s is not a valid recording file.\n", path);
+        fclose(file);
+        return FALSE;
+    }
+    if (header[4] != (uint32_t)map.numCols || header[5] != (uint32_t)map.numRows || header[6] != mapChecksum()) {
+        fprintf(stderr, "Error: %s was recorded on another map (%ux%u).\n", path, header[4], header[5]);
+        fclose(file);
+        return FALSE;
+    }
+
+    free(recording.inputs);
+    recording.inputs = (unsigned char*) malloc(header[3] > 0 ? header[3] : 1);
+    if (!recording.inputs || fread(recording.inputs, 1, header[3], file) != header[3]) {
+        fprintf(stderr, "Error reading recording file %s.\n", path);
+        fclose(file);
+        return FALSE;
+    }
+    fclose(file);
+    memcpy(&recording.tickLength, &header[2], sizeof(float));
+    recording.frames = (int)header[3];
+    recording.flags = header[7];
+    coherence.isEnabled = (recording.flags & RECORDING_COHERENT) != 0;
+    return TRUE;
+}
+
+void replayFrame(int frame) {
+    // Runs the simulation ticks of a recorded frame, with its input:
+    const unsigned char input = recording.inputs[frame];
+    player.walkDirection = ((input >> 4) & 3) - 1;
+    player.turnDirection = ((input >> 6) & 3) - 1;
+    for (int tick = 0; tick < (input & 15); tick++)
+        tickSimulation(recording.tickLength);
+}
+
+void freeRecording() {
+    free(recording.inputs);
+    recording.inputs = NULL;
+}
+// =========
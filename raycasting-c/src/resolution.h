@@ -0,0 +1,89 @@
+// Adaptive ray density:
+// =========
+// With camera.rayStride above 1, rays are only cast on every rayStride-th column of a tile, and on its last
+// column, so every column of a tile lies between two cast rays of the same tile, and tiles stay independent.
+// The columns in between still get their own direction, and either the hit of the nearest cast ray, or, when
+// the cast rays on both sides hit the same wall (the same content on the same grid line), their own hit
+// on that wall, where their direction crosses its grid line (exact, unless that wall has a gap in between).
+// Projection is unchanged, and still fills every column.
+// The stride can be fixed, or left to a controller that doubles it whenever the (smoothed) time spent casting
+// and projecting goes over a target, and halves it again once there's enough headroom for twice the rays.
+#define MAX_RAY_STRIDE 16
+#define RAY_STRIDE_SETTLE_FRAMES 30 // after a change, before the next one
+#define RAY_STRIDE_SMOOTHING 0.1    // of the frame time's moving average
+
+struct ResolutionController {
+    int isEnabled;
+    long long targetFrameTime; // nanoseconds, of casting and projecting a frame
+    long long lastFrameTime;
+    double frameTime;
+    int framesSinceChange;
+    int changes;
+} resolution;
+
+void fillRay(int stripId, int left, int right) {
+    // Gives the ray of a column in between the cast rays "left" and "right" a hit, keeping its own direction:
+    struct Ray* ray = &view->rays[stripId];
+    const struct Ray* a = &view->rays[left];
+    const struct Ray* b = &view->rays[right];
+    const int isSameWall = a->wallHitContent == b->wallHitContent && a->wasHitVertical == b->wasHitVertical &&
+        (a->wasHitVertical ? a->wallHit.x == b->wallHit.x : a->wallHit.y == b->wallHit.y);
+
+    ray->wallHitContent = a->wallHitContent;
+    ray->wasHitVertical = a->wasHitVertical;
+    if (camera.rayFill == RAY_FILL_INTERPOLATE && isSameWall && a->wasHitVertical && ray->direction.x != 0) {
+        ray->wallHit.x = a->wallHit.x;
+        ray->wallHit.y = view->position.y + (a->wallHit.x - view->position.x) * ray->direction.y / ray->direction.x;
+    } else if (camera.rayFill == RAY_FILL_INTERPOLATE && isSameWall && !a->wasHitVertical && ray->direction.y != 0) {
+        ray->wallHit.y = a->wallHit.y;
+        ray->wallHit.x = view->position.x + (a->wallHit.y - view->position.y) * ray->direction.x / ray->direction.y;
+    } else {
+        const struct Ray* nearest = (stripId - left) <= (right - stripId) ? a : b;
+        ray->wallHit = nearest->wallHit;
+        ray->wallHitContent = nearest->wallHitContent;
+        ray->wasHitVertical = nearest->wasHitVertical;
+    }
+}
+
+void fillRayGaps(int firstStrip, int lastStrip) {
+    // Fills the columns between the rays cast on a tile (which already have their directions):
+    for (int left = firstStrip; left < lastStrip - 1; left += camera.rayStride) {
+        const int right = left + camera.rayStride < lastStrip - 1 ? left + camera.rayStride : lastStrip - 1;
+        for (int stripId = left + 1; stripId < right; stripId++)
+            fillRay(stripId, left, right);
+    }
+}
+
+void setRayStride(int stride) {
+    camera.rayStride = stride < 1 ? 1 : (stride > MAX_RAY_STRIDE ? MAX_RAY_STRIDE : stride);
+}
+
+void adjustRayStride(long long frameTime) {
+    // Halving the stride can at most double the time spent casting, and projecting doesn't change
+    // (frames the coherence cache skipped took no time at all, so they don't count):
+    if (!resolution.isEnabled || coherence.isFrameSkipped)
+        return;
+    resolution.frameTime = resolution.frameTime > 0 ?
+        resolution.frameTime + RAY_STRIDE_SMOOTHING * (frameTime - resolution.frameTime) : (double)frameTime;
+    if (++resolution.framesSinceChange < RAY_STRIDE_SETTLE_FRAMES)
+        return;
+
+    const int stride = camera.rayStride;
+    if (resolution.frameTime > resolution.targetFrameTime && stride < MAX_RAY_STRIDE)
+        setRayStride(stride * 2);
+    else if (resolution.frameTime * 2 < resolution.targetFrameTime && stride > 1)
+        setRayStride(stride / 2);
+    if (camera.rayStride != stride) {
+        resolution.framesSinceChange = 0;
+        resolution.changes++;
+    }
+}
+
+void startResolutionController(double targetMilliseconds) {
+    resolution.isEnabled = targetMilliseconds > 0;
+    resolution.targetFrameTime = (long long)(targetMilliseconds * 1e6);
+    resolution.frameTime = 0;
+    resolution.framesSinceChange = 0;
+    resolution.changes = 0;
+}
+// =========
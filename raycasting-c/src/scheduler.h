@@ -0,0 +1,151 @@
+// Frame scheduler:
+// =========
+// The simulation (tickSimulation) runs at a fixed tick of SIMULATION_TICK_LENGTH, as many ticks per frame as the
+// time since the previous frame covers, independently of how often frames get rendered.
+// Rendering is paced one of several ways:
+//   FRAME_PACING_SLEEP:    capped at the target frame rate, sleeping until just before each frame is due
+//                          and spinning only for the last FRAME_SPIN_LENGTH of the wait
+//   FRAME_PACING_SPIN:     capped by spinning for the whole wait (the old behaviour, kept for comparison)
+//   FRAME_PACING_VSYNC:    not waiting at all, leaving it to the renderer to block on the display's refresh
+//   FRAME_PACING_UNCAPPED: not waiting at all
+// CPU utilization (of the whole process, all workers included) and frame interval jitter are counted over
+// windows of SCHEDULER_REPORT_LENGTH (by default) and reported at the end of each window.
+#include <errno.h>
+#include <time.h>
+
+#define NANOSECONDS_PER_SECOND 1000000000LL
+#define SIMULATION_TICK_LENGTH (NANOSECONDS_PER_SECOND / 60)
+#define MAX_SIMULATION_TICKS 8 // per frame, beyond which the simulation drops time instead of falling behind
+#define FRAME_SPIN_LENGTH 200000LL
+#define SCHEDULER_REPORT_LENGTH (5 * NANOSECONDS_PER_SECOND)
+
+enum FramePacing {
+    FRAME_PACING_SLEEP,
+    FRAME_PACING_SPIN,
+    FRAME_PACING_VSYNC,
+    FRAME_PACING_UNCAPPED
+};
+
+int framePacing = FRAME_PACING_SLEEP;
+int framesPerSecond = FPS;
+
+struct FrameScheduler {
+    int pacing;
+    long long frameLength;
+    long long nextFrame;
+    long long lastTick;
+    long long tickTime;
+    long long reportLength;
+
+    // Counters of the current report window:
+    long long windowStart;
+    long long windowCPUStart;
+    long long lastFrame;
+    int frames;
+    double intervals;
+    double squaredIntervals;
+    long long maxInterval;
+} scheduler;
+
+long long clockNanoseconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (long long)ts.tv_sec * NANOSECONDS_PER_SECOND + ts.tv_nsec;
+}
+
+void startScheduler(int pacing, int targetFramesPerSecond) {
+    const long long now = clockNanoseconds(CLOCK_MONOTONIC);
+    scheduler.pacing = pacing;
+    scheduler.frameLength = NANOSECONDS_PER_SECOND / (targetFramesPerSecond > 0 ? targetFramesPerSecond : FPS);
+    scheduler.nextFrame = now;
+    scheduler.lastTick = now;
+    scheduler.tickTime = 0;
+    scheduler.reportLength = SCHEDULER_REPORT_LENGTH;
+    scheduler.windowStart = now;
+    scheduler.windowCPUStart = clockNanoseconds(CLOCK_PROCESS_CPUTIME_ID);
+    scheduler.lastFrame = 0;
+    scheduler.frames = 0;
+    scheduler.intervals = scheduler.squaredIntervals = 0;
+    scheduler.maxInterval = 0;
+}
+
+int runSimulationTicks(void (*tick)(float deltaTime)) {
+    // Runs a tick for every whole SIMULATION_TICK_LENGTH elapsed, carrying the rest over to the next frame,
+    // and returns how many ran:
+    const long long now = clockNanoseconds(CLOCK_MONOTONIC);
+    scheduler.tickTime += now - scheduler.lastTick;
+    scheduler.lastTick = now;
+
+    int ticks = 0;
+    for (; scheduler.tickTime >= SIMULATION_TICK_LENGTH && ticks < MAX_SIMULATION_TICKS; ticks++) {
+        tick((float)SIMULATION_TICK_LENGTH / NANOSECONDS_PER_SECOND);
+        scheduler.tickTime -= SIMULATION_TICK_LENGTH;
+    }
+    if (ticks == MAX_SIMULATION_TICKS)
+        scheduler.tickTime = 0;
+    return ticks;
+}
+
+void sleepUntil(long long deadline) {
+    // Sleeps through most of the wait (which may oversleep by a scheduler quantum), then spins for the rest:
+    long long remaining = deadline - clockNanoseconds(CLOCK_MONOTONIC);
+    if (remaining > FRAME_SPIN_LENGTH) {
+        const long long sleepLength = remaining - FRAME_SPIN_LENGTH;
+        struct timespec ts = {(time_t)(sleepLength / NANOSECONDS_PER_SECOND), (long)(sleepLength % NANOSECONDS_PER_SECOND)};
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR);
+    }
+    while (clockNanoseconds(CLOCK_MONOTONIC) < deadline);
+}
+
+void printSchedulerReport(long long now) {
+    const double seconds = (double)(now - scheduler.windowStart) / NANOSECONDS_PER_SECOND;
+    const double cpuSeconds = (double)(clockNanoseconds(CLOCK_PROCESS_CPUTIME_ID) - scheduler.windowCPUStart) / NANOSECONDS_PER_SECOND;
+    const int intervals = scheduler.frames - 1;
+    const double mean = intervals > 0 ? scheduler.intervals / intervals : 0;
+    const double variance = intervals > 0 ? scheduler.squaredIntervals / intervals - mean * mean : 0;
+    printf("frames/sec: %.1f, cpu: %.1f%%, frame interval: %.2fms mean, %.3fms jitter (std dev), %.2fms max\n",
+        scheduler.frames / seconds,
+        100 * cpuSeconds / seconds,
+        mean / 1e6,
+        sqrt(variance > 0 ? variance : 0) / 1e6,
+        scheduler.maxInterval / 1e6
+    );
+}
+
+void countFrame() {
+    const long long now = clockNanoseconds(CLOCK_MONOTONIC);
+    if (scheduler.frames > 0) {
+        const long long interval = now - scheduler.lastFrame;
+        scheduler.intervals += (double)interval;
+        scheduler.squaredIntervals += (double)interval * (double)interval;
+        scheduler.maxInterval = interval > scheduler.maxInterval ? interval : scheduler.maxInterval;
+    }
+    scheduler.lastFrame = now;
+    scheduler.frames++;
+
+    if (now - scheduler.windowStart >= scheduler.reportLength) {
+        printSchedulerReport(now);
+        scheduler.windowStart = now;
+        scheduler.windowCPUStart = clockNanoseconds(CLOCK_PROCESS_CPUTIME_ID);
+        scheduler.frames = 0;
+        scheduler.intervals = scheduler.squaredIntervals = 0;
+        scheduler.maxInterval = 0;
+    }
+}
+
+void waitForNextFrame() {
+    if (scheduler.pacing == FRAME_PACING_SLEEP || scheduler.pacing == FRAME_PACING_SPIN) {
+        // Frames are due at fixed intervals, unless a frame ran so late that catching up is pointless:
+        const long long now = clockNanoseconds(CLOCK_MONOTONIC);
+        scheduler.nextFrame += scheduler.frameLength;
+        if (scheduler.nextFrame < now - scheduler.frameLength)
+            scheduler.nextFrame = now;
+
+        if (scheduler.pacing == FRAME_PACING_SLEEP)
+            sleepUntil(scheduler.nextFrame);
+        else
+            while (clockNanoseconds(CLOCK_MONOTONIC) < scheduler.nextFrame);
+    }
+    countFrame();
+}
+// =========
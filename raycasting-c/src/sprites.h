@@ -0,0 +1,247 @@
+// Sprites:
+// =========
+// Sprites are billboards standing on the floor (pickups, characters...), always facing the camera, drawn over
+// the walls, floors and ceilings once a view has been projected. Projection keeps each column's perpendicular
+// distance to its wall in the view's z-buffer, and a sprite column is only drawn where the sprite is closer.
+// Sprites are moved into camera space by the inverse of the view's rotation matrix, which turns them into a
+// depth along the orientation and an offset along its perpendicular, so like the rays, they need no angles:
+// the offset over the depth is the tangent from the orientation, and the view's frustum is the range of
+// tangents between the first and last columns' (from the rotation amounts -FOV_RATIO and +FOV_RATIO).
+// Columns aren't equally spaced in tangents (rays are spread by equal rotation amounts), so the columns a
+// sprite covers are found by a binary search over column_tangents, rather than by scaling.
+// The visible sprites are culled and sorted back to front once per frame, before projecting, and each tile
+// then draws the ones over it right after projecting its columns (while they're still in its column buffer),
+// in order, so nearer sprites cover farther ones without a per-pixel test.
+// Texels of 0 are transparent. (Only the player's view draws sprites)
+#define NUM_SPRITE_TEXTURES 3
+#define SPRITE_NEAR_DEPTH (TILE_SIZE / 8) // sprites nearer than this are culled
+
+struct Sprite {
+    vec2 position;
+    float scale; // the sprite's width and height, in tiles
+    int texture;
+};
+
+struct VisibleSprite {
+    float depth;
+    float left;  // the offset of the sprite's left edge from the orientation, in map units
+    float width; // in map units
+    int firstColumn;
+    int lastColumn; // one past the last column
+    int top;        // the row of the sprite's top, which can be above the screen
+    int height;     // in rows
+    int texture;
+};
+
+struct Sprites {
+    struct Sprite* sprites;
+    int count;
+    int capacity;
+    struct VisibleSprite* visible;
+    int visibleCount;
+} sprites;
+
+Uint32* spriteTextures = NULL;
+
+Uint32 generateSpriteTexel(int texture, int x, int y) {
+    const int dx = 2 * x - TEXTURE_WIDTH + 1;
+    const int dy = 2 * y - TEXTURE_HEIGHT + 1;
+    const int noise = textureNoise(x, y, texture + NUM_TEXTURES);
+    switch (texture) {
+        case 0: { // a gold coin
+            const int radius = TEXTURE_WIDTH / 2 - 2;
+            const int distance = (dx * dx + dy * dy) / 4;
+            if (distance > radius * radius)
+                return 0;
+            return distance > (radius - 4) * (radius - 4) ? textureColor(180, 130, 20) : textureColor(240 + noise, 200 + noise, 50);
+        }
+        case 1: { // a green barrel, on the bottom half
+            if (y < TEXTURE_HEIGHT / 2 || abs(dx) > TEXTURE_WIDTH / 2)
+                return 0;
+            const int isHoop = (y % 12) < 2;
+            return isHoop ? textureColor(90, 90, 100) : textureColor(40 + noise, 120 + noise - abs(dx), 50);
+        }
+        default: { // a red figure: a head over a body
+            const int headY = dy + TEXTURE_HEIGHT / 2;
+            const int isHead = dx * dx + headY * headY < (TEXTURE_WIDTH / 4) * (TEXTURE_WIDTH / 4);
+            const int isBody = y > TEXTURE_HEIGHT / 3 && abs(dx) < TEXTURE_WIDTH / 2 - (y - TEXTURE_HEIGHT / 3) / 4;
+            if (isHead)
+                return textureColor(230 + noise, 180 + noise, 150);
+            return isBody ? textureColor(170 + noise, 30, 40) : 0;
+        }
+    }
+}
+
+void generateSpriteTextures() {
+    // Column-major, as the wall textures:
+    spriteTextures = (Uint32*) malloc(sizeof(Uint32) * TEXTURE_SIZE * NUM_SPRITE_TEXTURES);
+    if (!spriteTextures) {
+        fprintf(stderr, "Error allocating sprite textures.\n");
+        exit(1);
+    }
+    for (int texture = 0; texture < NUM_SPRITE_TEXTURES; texture++)
+        for (int x = 0; x < TEXTURE_WIDTH; x++)
+            for (int y = 0; y < TEXTURE_HEIGHT; y++)
+                spriteTextures[(size_t)((texture * TEXTURE_WIDTH) + x) * TEXTURE_HEIGHT + y] = generateSpriteTexel(texture, x, y);
+}
+
+int addSprite(float x, float y, float scale, int texture) {
+    if (!spriteTextures)
+        generateSpriteTextures();
+    if (sprites.count == sprites.capacity) {
+        const int capacity = sprites.capacity ? sprites.capacity * 2 : 64;
+        struct Sprite* all = (struct Sprite*) realloc(sprites.sprites, sizeof(struct Sprite) * capacity);
+        struct VisibleSprite* visible = (struct VisibleSprite*) realloc(sprites.visible, sizeof(struct VisibleSprite) * capacity);
+        if (all)
+            sprites.sprites = all;
+        if (visible)
+            sprites.visible = visible;
+        if (!all || !visible) {
+            fprintf(stderr, "Error allocating sprites.\n");
+            return FALSE;
+        }
+        sprites.capacity = capacity;
+    }
+    struct Sprite* sprite = &sprites.sprites[sprites.count++];
+    sprite->position.x = x;
+    sprite->position.y = y;
+    sprite->scale = scale;
+    sprite->texture = texture % NUM_SPRITE_TEXTURES;
+    // The last frame drawn doesn't have it:
+    invalidateCoherenceCache();
+    return TRUE;
+}
+
+int scatterSprites(int count, unsigned int seed) {
+    // Puts sprites at random spots of empty cells, of random textures and sizes:
+    unsigned int random = seed ? seed : 1;
+    const int maxAttempts = count * 100;
+    for (int attempts = 0; count > 0 && attempts < maxAttempts; attempts++) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        const float x = (float)(random % (unsigned int)map.width);
+        const float y = (float)((random / (unsigned int)map.width) % (unsigned int)map.height);
+        if (mapContentAt((int)(x / TILE_SIZE), (int)(y / TILE_SIZE)) != 0)
+            continue;
+        if (!addSprite(x, y, 0.25f + (float)(random % 4) / 8, (int)(random >> 24)))
+            return FALSE;
+        count--;
+    }
+    return TRUE;
+}
+
+void freeSprites() {
+    free(sprites.sprites);
+    free(sprites.visible);
+    free(spriteTextures);
+    memset(&sprites, 0, sizeof(sprites));
+    spriteTextures = NULL;
+}
+
+int findColumn(float tangent) {
+    // The first column whose ray's tangent is at least the given one (NUM_RAYS if none):
+    int first = 0, last = NUM_RAYS;
+    while (first < last) {
+        const int middle = (first + last) / 2;
+        if (column_tangents[middle] < tangent)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    return first;
+}
+
+int compareVisibleSprites(const void* a, const void* b) {
+    // Back to front:
+    const float x = ((const struct VisibleSprite*)a)->depth;
+    const float y = ((const struct VisibleSprite*)b)->depth;
+    return (x < y) - (x > y);
+}
+
+void setVisibleSprites() {
+    // Culls the sprites against the view's frustum, and sorts the rest back to front:
+    const float distanceProjPlane = (WINDOW_WIDTH / 2) * (FOCAL_LENGTH / 2);
+    const float firstTangent = column_tangents[0];
+    const float lastTangent = column_tangents[NUM_RAYS - 1];
+    vec2 inverse = {view->orientation.x, -view->orientation.y};
+    mat2 toCamera;
+    setRotationMatrix(&toCamera, &inverse);
+
+    sprites.visibleCount = 0;
+    for (int i = 0; i < sprites.count; i++) {
+        struct Sprite* sprite = &sprites.sprites[i];
+        // (x, y) becomes (depth, offset):
+        vec2 relative;
+        setDirection(&relative, &view->position, &sprite->position);
+        multiply(&relative, &toCamera);
+
+        const float depth = relative.x;
+        const float width = sprite->scale * TILE_SIZE;
+        const float left = relative.y - width / 2;
+        if (depth < SPRITE_NEAR_DEPTH || left + width < firstTangent * depth || left > lastTangent * depth)
+            continue;
+        const int firstColumn = findColumn(left / depth);
+        const int lastColumn = findColumn((left + width) / depth);
+        if (firstColumn == lastColumn)
+            continue;
+
+        // Standing on the floor, whose horizon is halfway up a wall:
+        const int wallHeight = (int)((TILE_SIZE / depth) * distanceProjPlane);
+        struct VisibleSprite* visible = &sprites.visible[sprites.visibleCount++];
+        visible->depth = depth;
+        visible->left = left;
+        visible->width = width;
+        visible->firstColumn = firstColumn;
+        visible->lastColumn = lastColumn;
+        visible->height = (int)(wallHeight * sprite->scale) > 1 ? (int)(wallHeight * sprite->scale) : 1;
+        visible->top = (WINDOW_HEIGHT / 2) + (wallHeight / 2) - visible->height;
+        visible->texture = sprite->texture;
+    }
+    qsort(sprites.visible, sprites.visibleCount, sizeof(struct VisibleSprite), compareVisibleSprites);
+}
+
+void drawSpriteTile(int firstStrip, int lastStrip, Uint32* pixels, int columnStride, int rowStride) {
+    // Over the tile's projected columns, with the pixel of column i and row y at
+    // pixels[(i - firstStrip) * columnStride + y * rowStride]:
+    for (int s = 0; s < sprites.visibleCount; s++) {
+        const struct VisibleSprite* sprite = &sprites.visible[s];
+        const int firstColumn = sprite->firstColumn > firstStrip ? sprite->firstColumn : firstStrip;
+        const int lastColumn = sprite->lastColumn < lastStrip ? sprite->lastColumn : lastStrip;
+        if (firstColumn >= lastColumn)
+            continue;
+
+        const int top = sprite->top > 0 ? sprite->top : 0;
+        const int bottom = sprite->top + sprite->height < WINDOW_HEIGHT ? sprite->top + sprite->height : WINDOW_HEIGHT;
+        const Uint32 textureStep = (Uint32)(((uint64_t)TEXTURE_HEIGHT << TEXTURE_V_BITS) / (uint64_t)sprite->height);
+        const float texelsPerUnit = TEXTURE_WIDTH / sprite->width;
+        for (int i = firstColumn; i < lastColumn; i++) {
+            if (sprite->depth >= view->zBuffer[i])
+                continue;
+            // Where the column's ray crosses the sprite's plane:
+            int textureOffsetX = (int)((column_tangents[i] * sprite->depth - sprite->left) * texelsPerUnit);
+            textureOffsetX = textureOffsetX < 0 ? 0 : (textureOffsetX >= TEXTURE_WIDTH ? TEXTURE_WIDTH - 1 : textureOffsetX);
+            const Uint32* texels = &spriteTextures[(size_t)((sprite->texture * TEXTURE_WIDTH) + textureOffsetX) * TEXTURE_HEIGHT];
+
+            Uint32* column = &pixels[(i - firstStrip) * columnStride];
+            Uint32 textureY = (Uint32)(top - sprite->top) * textureStep;
+            for (int y = top; y < bottom; y++) {
+                const Uint32 texel = texels[textureY >> TEXTURE_V_BITS];
+                if (texel)
+                    column[rowStride * y] = texel;
+                textureY += textureStep;
+            }
+        }
+    }
+}
+
+void setFrameSprites() {
+    // The sprites the tiles of the player's view will draw this frame:
+    sprites.visibleCount = 0;
+    if (sprites.count == 0 || playerView.depthColumns)
+        return;
+    PROFILE_BEGIN(PROFILE_SPRITES);
+    setVisibleSprites();
+    PROFILE_END(PROFILE_SPRITES);
+}
+// =========
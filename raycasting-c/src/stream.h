@@ -0,0 +1,206 @@
+// Frame streaming:
+// =========
+// With --stream ADDRESS (unix:PATH, or tcp:PORT), the headless renderer waits for a viewer to connect there
+// (see viewer/viewer.c), then sends it every frame of colorBuffer, coded as the columns that changed since the
+// previous frame (see columncodec.h). Textured walls, floors and ceilings rarely have long runs of one color,
+// so most of the savings come from the columns and pixels that didn't change, which the coherence cache, the
+// ray stride and map edits all leave behind.
+// Columns are coded tile by tile on the workers, each tile into its own buffer, and sent in order. A tile's
+// columns are first gathered from the frame into the worker's column-major scratch buffer (see gatherTile()
+// in transpose.h), and the previous frame is kept column-major, so every column is coded from contiguous
+// pixels instead of walking down the row-major frame a cache line (and often a page) per pixel.
+// The counters cover how much was sent against the raw frames, and how long coding and sending took on this
+// side; the viewer measures the latency from each frame being rendered to it being decoded.
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "columncodec.h"
+
+#define STREAM_TILE_CAPACITY (COLUMN_TILE_WIDTH * COLUMN_MAX_CODED_SIZE(WINDOW_HEIGHT))
+
+struct Stream {
+    int socket; // the viewer's, or -1
+    const char* address;
+    Uint32* previousPixels; // as the viewer has them, column-major
+    const Uint32* pixels;   // of the frame being coded
+    unsigned char* tileBuffers;
+    size_t tileSizes[NUM_COLUMN_TILES];
+    int tileColumns[NUM_COLUMN_TILES];
+
+    // Counters:
+    long long frames;
+    long long columns;
+    long long bytes;
+    long long rawBytes;
+    long long encodeTime;
+    long long sendTime;
+    long long startTime;
+} stream = {.socket = -1};
+
+int openStreamSocket(const char* address) {
+    // Listens on the address, and waits for the viewer:
+    int listener = -1;
+    if (!strncmp(address, "unix:", 5)) {
+        struct sockaddr_un local;
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        strncpy(local.sun_path, address + 5, sizeof(local.sun_path) - 1);
+        unlink(local.sun_path);
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener >= 0 && (bind(listener, (struct sockaddr*)&local, sizeof(local)) != 0 || listen(listener, 1) != 0)) {
+            close(listener);
+            listener = -1;
+        }
+    } else if (!strncmp(address, "tcp:", 4)) {
+        struct sockaddr_in any;
+        memset(&any, 0, sizeof(any));
+        any.sin_family = AF_INET;
+        any.sin_addr.s_addr = htonl(INADDR_ANY);
+        any.sin_port = htons((uint16_t)atoi(address + 4));
+        const int reuse = 1;
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (listener >= 0 && (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+            bind(listener, (struct sockaddr*)&any, sizeof(any)) != 0 || listen(listener, 1) != 0)) {
+            close(listener);
+            listener = -1;
+        }
+    } else {
+        fprintf(stderr, "Error: stream addresses are unix:PATH or tcp:PORT, not %s.\n", address);
+        return -1;
+    }
+    if (listener < 0) {
+        fprintf(stderr, "Error listening on %s: %s\n", address, strerror(errno));
+        return -1;
+    }
+
+    printf("waiting for a viewer on %s\n", address);
+    fflush(stdout);
+    const int viewer = accept(listener, NULL, NULL);
+    close(listener);
+    if (viewer < 0)
+        fprintf(stderr, "Error accepting a viewer on %s: %s\n", address, strerror(errno));
+    else if (!strncmp(address, "tcp:", 4)) {
+        // Frames are sent whole, so they shouldn't wait for more to send:
+        const int noDelay = 1;
+        setsockopt(viewer, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    }
+    return viewer;
+}
+
+int sendAll(const void* data, size_t size) {
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        const ssize_t sent = send(stream.socket, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return FALSE;
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+    return TRUE;
+}
+
+void stopStream() {
+    if (stream.socket >= 0)
+        close(stream.socket);
+    stream.socket = -1;
+    free(stream.previousPixels);
+    free(stream.tileBuffers);
+    stream.previousPixels = NULL;
+    stream.tileBuffers = NULL;
+}
+
+int startStream(const char* address) {
+    // After setup():
+    stream.address = address;
+    stream.previousPixels = (Uint32*) calloc((size_t)WINDOW_WIDTH * WINDOW_HEIGHT, sizeof(Uint32));
+    stream.tileBuffers = (unsigned char*) malloc(STREAM_TILE_CAPACITY * NUM_COLUMN_TILES);
+    if (!stream.previousPixels || !stream.tileBuffers) {
+        fprintf(stderr, "Error allocating the stream's buffers.\n");
+        stopStream();
+        return FALSE;
+    }
+    if ((stream.socket = openStreamSocket(address)) < 0) {
+        stopStream();
+        return FALSE;
+    }
+
+    struct StreamHeader header;
+    memcpy(header.magic, STREAM_MAGIC, 4);
+    header.version = STREAM_VERSION;
+    header.width = WINDOW_WIDTH;
+    header.height = WINDOW_HEIGHT;
+    if (!sendAll(&header, sizeof(header))) {
+        fprintf(stderr, "Error sending to the viewer.\n");
+        stopStream();
+        return FALSE;
+    }
+    stream.startTime = clockNanoseconds(CLOCK_MONOTONIC);
+    return TRUE;
+}
+
+void encodeStreamTile(int tile) {
+    const int firstStrip = tile * COLUMN_TILE_WIDTH;
+    const int lastStrip = firstStrip + COLUMN_TILE_WIDTH < NUM_RAYS ? firstStrip + COLUMN_TILE_WIDTH : NUM_RAYS;
+    const int numColumns = lastStrip - firstStrip;
+    gatherTile(stream.pixels, firstStrip, numColumns, tileColumns);
+
+    unsigned char* out = &stream.tileBuffers[(size_t)tile * STREAM_TILE_CAPACITY];
+    size_t size = 0;
+    int columns = 0;
+    for (int i = 0; i < numColumns; i++) {
+        const size_t columnSize = encodeColumn(&out[size], firstStrip + i,
+            &stream.previousPixels[(size_t)(firstStrip + i) * WINDOW_HEIGHT], &tileColumns[i * WINDOW_HEIGHT], 1, WINDOW_HEIGHT);
+        size += columnSize;
+        columns += columnSize > 0;
+    }
+    stream.tileSizes[tile] = size;
+    stream.tileColumns[tile] = columns;
+}
+
+int streamFrame(const Uint32* pixels, int frame, long long renderedAt) {
+    // Sends the frame's changed columns, and stops streaming if the viewer is gone:
+    const long long start = clockNanoseconds(CLOCK_MONOTONIC);
+    stream.pixels = pixels;
+    runWorkers(encodeStreamTile, NUM_COLUMN_TILES);
+
+    struct StreamFrameHeader header = {(uint32_t)frame, 0, 0, sizeof(Uint32) * WINDOW_WIDTH * WINDOW_HEIGHT, (uint64_t)renderedAt};
+    for (int tile = 0; tile < NUM_COLUMN_TILES; tile++) {
+        header.columns += (uint32_t)stream.tileColumns[tile];
+        header.payloadSize += (uint32_t)stream.tileSizes[tile];
+    }
+    const long long encoded = clockNanoseconds(CLOCK_MONOTONIC);
+
+    int isSent = sendAll(&header, sizeof(header));
+    for (int tile = 0; tile < NUM_COLUMN_TILES && isSent; tile++)
+        isSent = sendAll(&stream.tileBuffers[(size_t)tile * STREAM_TILE_CAPACITY], stream.tileSizes[tile]);
+    if (!isSent) {
+        fprintf(stderr, "The viewer on %s is gone, so streaming stopped.\n", stream.address);
+        stopStream();
+        return FALSE;
+    }
+
+    stream.frames++;
+    stream.columns += header.columns;
+    stream.bytes += sizeof(header) + header.payloadSize;
+    stream.rawBytes += header.rawSize;
+    stream.encodeTime += encoded - start;
+    stream.sendTime += clockNanoseconds(CLOCK_MONOTONIC) - encoded;
+    return TRUE;
+}
+
+void printStreamReport() {
+    const double seconds = (clockNanoseconds(CLOCK_MONOTONIC) - stream.startTime) / 1e9;
+    const long long frames = stream.frames > 0 ? stream.frames : 1;
+    printf("stream: %lld frames to %s, %.1f%% of columns sent, %.2f MB/frame (%.1f%% of raw), %.2f MB/s\n",
+        stream.frames, stream.address, 100.0 * stream.columns / ((double)frames * NUM_RAYS),
+        stream.bytes / 1e6 / frames, stream.rawBytes > 0 ? 100.0 * stream.bytes / stream.rawBytes : 0.0,
+        seconds > 0 ? stream.bytes / 1e6 / seconds : 0.0);
+    printf("stream: %.3fms coding and %.3fms sending per frame\n", stream.encodeTime / 1e6 / frames, stream.sendTime / 1e6 / frames);
+}
+// =========
@@ -0,0 +1,95 @@
+// Wall textures:
+// =========
+// All wall textures live in one contiguous atlas that's generated at startup.
+// Each texture is stored column-major (TEXTURE_HEIGHT texels per column), so a screen column samples
+// a single texture column sequentially, from top to bottom.
+// The atlas holds every texture twice: as is for walls hit on a vertical grid line, followed by
+// a darker copy for walls hit on a horizontal one, so walls are shaded without any per-pixel work.
+// Texels are stepped through in fixed-point, with TEXTURE_V_BITS fractional bits, so a column costs
+// one divide. (TEXTURE_HEIGHT << TEXTURE_V_BITS must fit in 32 bits)
+#define TEXTURE_V_BITS 24
+#define TEXTURE_SIZE (TEXTURE_WIDTH * TEXTURE_HEIGHT)
+
+Uint32* wallTextures = NULL;
+
+Uint32 textureColor(int red, int green, int blue) {
+    red = red < 0 ? 0 : (red > 255 ? 255 : red);
+    green = green < 0 ? 0 : (green > 255 ? 255 : green);
+    blue = blue < 0 ? 0 : (blue > 255 ? 255 : blue);
+    return 0xFF000000 | ((Uint32)red << 16) | ((Uint32)green << 8) | (Uint32)blue;
+}
+
+int textureNoise(int x, int y, int seed) {
+    // A cheap repeatable hash of the texel's coordinates, between -16 and 15:
+    unsigned int hash = (unsigned int)x * 374761393u + (unsigned int)y * 668265263u + (unsigned int)seed * 982451653u;
+    hash = (hash ^ (hash >> 13)) * 1274126177u;
+    return (int)((hash ^ (hash >> 16)) & 31) - 16;
+}
+
+Uint32 generateTexel(int texture, int x, int y) {
+    const int noise = textureNoise(x, y, texture);
+    switch (texture) {
+        case 0: { // red bricks
+            const int row = y / 16;
+            const int isMortar = (y % 16) == 0 || ((x + (row & 1) * 16) % 32) == 0;
+            return isMortar ? textureColor(150 + noise, 150 + noise, 140 + noise) : textureColor(160 + noise, 50 + noise / 2, 40);
+        }
+        case 1: { // grey stone blocks
+            const int isMortar = (y % 32) < 2 || (x % 32) < 2;
+            return isMortar ? textureColor(60, 60, 60) : textureColor(120 + noise * 2, 120 + noise * 2, 125 + noise * 2);
+        }
+        case 2: { // wooden planks
+            const int grain = (x % 16) == 0 ? -50 : (int)(20 * sin((x + y / 8) * 0.8));
+            return textureColor(130 + grain + noise, 85 + grain / 2 + noise / 2, 45 + noise / 4);
+        }
+        case 3: { // blue checker tiles
+            const int isDark = ((x / 16) + (y / 16)) & 1;
+            return isDark ? textureColor(30, 50 + noise, 120 + noise) : textureColor(70, 100 + noise, 180 + noise);
+        }
+        case 4: { // mossy bricks
+            const int row = y / 8;
+            const int isMortar = (y % 8) == 0 || ((x + (row & 1) * 8) % 16) == 0;
+            return isMortar ? textureColor(40, 70 + noise, 30) : textureColor(100 + noise, 110 + noise, 80 + noise);
+        }
+        case 5: { // purple xor pattern
+            const int pattern = (x ^ y) * 4;
+            return textureColor(pattern / 2 + 60, 20, pattern / 2 + 90);
+        }
+        case 6: { // yellow rings
+            const int dx = x - TEXTURE_WIDTH / 2;
+            const int dy = y - TEXTURE_HEIGHT / 2;
+            const int ring = (int)sqrt((double)(dx * dx + dy * dy)) / 4;
+            return (ring & 1) ? textureColor(200 + noise, 170 + noise, 40) : textureColor(120 + noise, 90 + noise, 20);
+        }
+        default: { // teal diagonal stripes
+            const int isStripe = ((x + y) / 8) & 1;
+            return isStripe ? textureColor(20, 140 + noise, 130 + noise) : textureColor(10, 80 + noise, 90 + noise);
+        }
+    }
+}
+
+void generateTextures() {
+    wallTextures = (Uint32*) malloc(sizeof(Uint32) * TEXTURE_SIZE * NUM_TEXTURES * 2);
+    if (!wallTextures) {
+        fprintf(stderr, "Error allocating wall textures.\n");
+        exit(1);
+    }
+    for (int texture = 0; texture < NUM_TEXTURES; texture++) {
+        for (int x = 0; x < TEXTURE_WIDTH; x++) {
+            for (int y = 0; y < TEXTURE_HEIGHT; y++) {
+                const Uint32 color = generateTexel(texture, x, y);
+                const size_t index = (size_t)((texture * TEXTURE_WIDTH) + x) * TEXTURE_HEIGHT + y;
+                wallTextures[index] = color;
+                // The darker copy, at 80% (as 0xFFCCCCCC was to 0xFFFFFFFF for untextured walls):
+                wallTextures[index + TEXTURE_SIZE * NUM_TEXTURES] =
+                    0xFF000000 | ((((color >> 16) & 0xFF) * 4 / 5) << 16) | ((((color >> 8) & 0xFF) * 4 / 5) << 8) | ((color & 0xFF) * 4 / 5);
+            }
+        }
+    }
+}
+
+void freeTextures() {
+    free(wallTextures);
+    wallTextures = NULL;
+}
+// =========
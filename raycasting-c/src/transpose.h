@@ -0,0 +1,215 @@
+// Column-major projection:
+// =========
+// The projection fills the screen one column at a time, which in the row-major colorBuffer SDL expects
+// is a stride of a whole row (and so a new cache line) per pixel.
+// Instead, each worker fills the columns of a tile into its own column-major scratch buffer, where every
+// column is contiguous, and then transposes the tile into colorBuffer in square blocks of 4x4 (SSE2) or
+// 8x8 (AVX2) pixels, writing each row of the tile as whole cache lines.
+// The scratch buffer of a tile (COLUMN_TILE_WIDTH x WINDOW_HEIGHT pixels) stays in the worker's cache,
+// and colorBuffer is written with non-temporal stores, so it's never read into the cache just to be overwritten.
+// The other way around, gatherTile() reads a tile of a row-major frame back into the column-major scratch
+// buffer (for the stream's column coder, see stream.h), with the same blocks.
+
+typedef void (*TransposeKernel)(const Uint32* columns, int firstColumn, int numColumns);
+typedef void (*GatherKernel)(const Uint32* pixels, int firstColumn, int numColumns, Uint32* columns);
+
+int isColumnMajorProjection = TRUE;
+__thread Uint32 tileColumns[COLUMN_TILE_WIDTH * WINDOW_HEIGHT];
+
+void transposeTileScalar(const Uint32* columns, int firstColumn, int numColumns) {
+    for (int y = 0; y < WINDOW_HEIGHT; y++)
+        for (int x = 0; x < numColumns; x++)
+            view->colorBuffer[(WINDOW_WIDTH * y) + firstColumn + x] = columns[(WINDOW_HEIGHT * x) + y];
+}
+
+void gatherTileScalar(const Uint32* pixels, int firstColumn, int numColumns, Uint32* columns) {
+    for (int y = 0; y < WINDOW_HEIGHT; y++)
+        for (int x = 0; x < numColumns; x++)
+            columns[(WINDOW_HEIGHT * x) + y] = pixels[(WINDOW_WIDTH * y) + firstColumn + x];
+}
+
+TransposeKernel transposeTile = transposeTileScalar;
+GatherKernel gatherTile = gatherTileScalar;
+const char* transposeKernelName = "scalar";
+
+#ifdef PACKET_SIMD
+void transposeTileRemainder(const Uint32* columns, int firstColumn, int numColumns, int blockSize) {
+    // The pixels of rows and columns left over past the last whole block:
+    const int blockColumns = numColumns - numColumns % blockSize;
+    const int blockRows = WINDOW_HEIGHT - WINDOW_HEIGHT % blockSize;
+    for (int y = 0; y < WINDOW_HEIGHT; y++)
+        for (int x = y < blockRows ? blockColumns : 0; x < numColumns; x++)
+            view->colorBuffer[(WINDOW_WIDTH * y) + firstColumn + x] = columns[(WINDOW_HEIGHT * x) + y];
+}
+
+void gatherTileRemainder(const Uint32* pixels, int firstColumn, int numColumns, Uint32* columns, int blockSize) {
+    const int blockColumns = numColumns - numColumns % blockSize;
+    const int blockRows = WINDOW_HEIGHT - WINDOW_HEIGHT % blockSize;
+    for (int y = 0; y < WINDOW_HEIGHT; y++)
+        for (int x = y < blockRows ? blockColumns : 0; x < numColumns; x++)
+            columns[(WINDOW_HEIGHT * x) + y] = pixels[(WINDOW_WIDTH * y) + firstColumn + x];
+}
+
+__attribute__((target("sse2")))
+void transposeTileSSE2(const Uint32* columns, int firstColumn, int numColumns) {
+    // The same as transposeTileAVX2() (below), with bands of 4 rows:
+    __attribute__((aligned(16))) Uint32 band[4][COLUMN_TILE_WIDTH];
+    const int blockColumns = numColumns & ~3;
+    const int isStreamed = ((size_t)&view->colorBuffer[firstColumn] & 15) == 0;
+    for (int y = 0; y + 4 <= WINDOW_HEIGHT; y += 4) {
+        for (int x = 0; x < blockColumns; x += 4) {
+            const Uint32* source = &columns[(WINDOW_HEIGHT * x) + y];
+            const __m128i c0 = _mm_loadu_si128((const __m128i*)(source));
+            const __m128i c1 = _mm_loadu_si128((const __m128i*)(source + WINDOW_HEIGHT));
+            const __m128i c2 = _mm_loadu_si128((const __m128i*)(source + WINDOW_HEIGHT * 2));
+            const __m128i c3 = _mm_loadu_si128((const __m128i*)(source + WINDOW_HEIGHT * 3));
+
+            const __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+            const __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+            const __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+            const __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+
+            _mm_store_si128((__m128i*)&band[0][x], _mm_unpacklo_epi64(t0, t1));
+            _mm_store_si128((__m128i*)&band[1][x], _mm_unpackhi_epi64(t0, t1));
+            _mm_store_si128((__m128i*)&band[2][x], _mm_unpacklo_epi64(t2, t3));
+            _mm_store_si128((__m128i*)&band[3][x], _mm_unpackhi_epi64(t2, t3));
+        }
+        for (int i = 0; i < 4; i++) {
+            Uint32* target = &view->colorBuffer[(WINDOW_WIDTH * (y + i)) + firstColumn];
+            for (int x = 0; x < blockColumns; x += 4) {
+                const __m128i row = _mm_load_si128((const __m128i*)&band[i][x]);
+                if (isStreamed)
+                    _mm_stream_si128((__m128i*)(target + x), row);
+                else
+                    _mm_storeu_si128((__m128i*)(target + x), row);
+            }
+        }
+    }
+    _mm_sfence();
+    transposeTileRemainder(columns, firstColumn, numColumns, 4);
+}
+
+__attribute__((target("sse2")))
+void gatherTileSSE2(const Uint32* pixels, int firstColumn, int numColumns, Uint32* columns) {
+    // Blocks of 4 rows of 4 pixels, transposed into 4 columns of 4 pixels:
+    const int blockColumns = numColumns & ~3;
+    for (int y = 0; y + 4 <= WINDOW_HEIGHT; y += 4) {
+        for (int x = 0; x < blockColumns; x += 4) {
+            const Uint32* source = &pixels[(WINDOW_WIDTH * y) + firstColumn + x];
+            const __m128i r0 = _mm_loadu_si128((const __m128i*)(source));
+            const __m128i r1 = _mm_loadu_si128((const __m128i*)(source + WINDOW_WIDTH));
+            const __m128i r2 = _mm_loadu_si128((const __m128i*)(source + WINDOW_WIDTH * 2));
+            const __m128i r3 = _mm_loadu_si128((const __m128i*)(source + WINDOW_WIDTH * 3));
+
+            const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+            const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+            const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+            const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+            Uint32* target = &columns[(WINDOW_HEIGHT * x) + y];
+            _mm_storeu_si128((__m128i*)(target), _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128((__m128i*)(target + WINDOW_HEIGHT), _mm_unpackhi_epi64(t0, t1));
+            _mm_storeu_si128((__m128i*)(target + WINDOW_HEIGHT * 2), _mm_unpacklo_epi64(t2, t3));
+            _mm_storeu_si128((__m128i*)(target + WINDOW_HEIGHT * 3), _mm_unpackhi_epi64(t2, t3));
+        }
+    }
+    gatherTileRemainder(pixels, firstColumn, numColumns, columns, 4);
+}
+
+__attribute__((target("avx2")))
+void transposeTileAVX2(const Uint32* columns, int firstColumn, int numColumns) {
+    // Whole rows of the tile are streamed straight to memory (colorBuffer is only read back by SDL),
+    // so rows are first gathered into a band of 8 rows that fits in L1, then written one after the other:
+    __attribute__((aligned(32))) Uint32 band[8][COLUMN_TILE_WIDTH];
+    const int blockColumns = numColumns & ~7;
+    const int isStreamed = ((size_t)&view->colorBuffer[firstColumn] & 31) == 0;
+    for (int y = 0; y + 8 <= WINDOW_HEIGHT; y += 8) {
+        for (int x = 0; x < blockColumns; x += 8) {
+            const Uint32* source = &columns[(WINDOW_HEIGHT * x) + y];
+            __m256i c[8], t[8], u[8];
+            for (int i = 0; i < 8; i++)
+                c[i] = _mm256_loadu_si256((const __m256i*)(source + WINDOW_HEIGHT * i));
+
+            // Interleave pairs of columns, then pairs of pairs, leaving rows y..y+3 in the low halves
+            // and rows y+4..y+7 in the high halves of u[]:
+            for (int i = 0; i < 8; i += 2) {
+                t[i] = _mm256_unpacklo_epi32(c[i], c[i + 1]);
+                t[i + 1] = _mm256_unpackhi_epi32(c[i], c[i + 1]);
+            }
+            for (int i = 0; i < 8; i += 4) {
+                u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+                u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+                u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+                u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+            }
+            for (int i = 0; i < 4; i++) {
+                _mm256_store_si256((__m256i*)&band[i][x], _mm256_permute2x128_si256(u[i], u[i + 4], 0x20));
+                _mm256_store_si256((__m256i*)&band[i + 4][x], _mm256_permute2x128_si256(u[i], u[i + 4], 0x31));
+            }
+        }
+        for (int i = 0; i < 8; i++) {
+            Uint32* target = &view->colorBuffer[(WINDOW_WIDTH * (y + i)) + firstColumn];
+            for (int x = 0; x < blockColumns; x += 8) {
+                const __m256i row = _mm256_load_si256((const __m256i*)&band[i][x]);
+                if (isStreamed)
+                    _mm256_stream_si256((__m256i*)(target + x), row);
+                else
+                    _mm256_storeu_si256((__m256i*)(target + x), row);
+            }
+        }
+    }
+    _mm_sfence();
+    transposeTileRemainder(columns, firstColumn, numColumns, 8);
+}
+
+__attribute__((target("avx2")))
+void gatherTileAVX2(const Uint32* pixels, int firstColumn, int numColumns, Uint32* columns) {
+    // The transpose of transposeTileAVX2(), from blocks of 8 rows of 8 pixels into 8 columns of 8 pixels:
+    const int blockColumns = numColumns & ~7;
+    for (int y = 0; y + 8 <= WINDOW_HEIGHT; y += 8) {
+        for (int x = 0; x < blockColumns; x += 8) {
+            const Uint32* source = &pixels[(WINDOW_WIDTH * y) + firstColumn + x];
+            __m256i r[8], t[8], u[8];
+            for (int i = 0; i < 8; i++)
+                r[i] = _mm256_loadu_si256((const __m256i*)(source + WINDOW_WIDTH * i));
+
+            for (int i = 0; i < 8; i += 2) {
+                t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+                t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+            }
+            for (int i = 0; i < 8; i += 4) {
+                u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+                u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+                u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+                u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+            }
+            Uint32* target = &columns[(WINDOW_HEIGHT * x) + y];
+            for (int i = 0; i < 4; i++) {
+                _mm256_storeu_si256((__m256i*)(target + WINDOW_HEIGHT * i), _mm256_permute2x128_si256(u[i], u[i + 4], 0x20));
+                _mm256_storeu_si256((__m256i*)(target + WINDOW_HEIGHT * (i + 4)), _mm256_permute2x128_si256(u[i], u[i + 4], 0x31));
+            }
+        }
+    }
+    gatherTileRemainder(pixels, firstColumn, numColumns, columns, 8);
+}
+#endif
+
+void selectTransposeKernel() {
+    // Picks the widest transpose the CPU supports:
+    transposeTile = transposeTileScalar;
+    gatherTile = gatherTileScalar;
+    transposeKernelName = "scalar";
+#ifdef PACKET_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        transposeTile = transposeTileAVX2;
+        gatherTile = gatherTileAVX2;
+        transposeKernelName = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        transposeTile = transposeTileSSE2;
+        gatherTile = gatherTileSSE2;
+        transposeKernelName = "sse2";
+    }
+#endif
+}
+// =========
@@ -0,0 +1,48 @@
+// Batch rendering of views:
+// =========
+// Renders any number of cameras in the loaded map in one call, into buffers of the caller's, for uses with
+// many views to render and no window (bots, agents, thumbnails...). Call setup() once first, and set or load
+// the map (see setMap() and loadMap()), which, like the textures and tables, all views share read-only.
+// Where the player's view is split into tiles across all workers, a batch is split into whole views, each
+// worker rendering one view at a time from start to end, through the same kernels, into its own rays,
+// so that views never wait on each other.
+// The camera settings (rayStride and rayFill) apply to batches too, but the coherence cache doesn't.
+struct CameraState {
+    vec2 position;
+    vec2 orientation; // a unit vector
+    Uint32* pixels;   // WINDOW_WIDTH x WINDOW_HEIGHT pixels, row-major (as colorBuffer)
+    struct DepthColumns* depthColumns; // projected into instead of pixels, unless NULL (see depth.h)
+};
+
+struct CameraState* batchCameras;
+__thread struct Ray batchRays[NUM_RAYS];
+__thread struct RaySlopes batchRaySlopes;
+__thread struct RayHits batchRayHits[NUM_RAYS];
+__thread float batchZBuffer[NUM_RAYS];
+
+void renderBatchView(int index) {
+    struct View batchView;
+    batchView.position = batchCameras[index].position;
+    batchView.orientation = batchCameras[index].orientation;
+    setRotationMatrix(&batchView.rotation_matrix, &batchView.orientation);
+    batchView.rays = batchRays;
+    batchView.raySlopes = &batchRaySlopes;
+    batchView.rayHits = batchRayHits;
+    batchView.zBuffer = batchZBuffer;
+    batchView.colorBuffer = batchCameras[index].pixels;
+    batchView.depthColumns = batchCameras[index].depthColumns;
+
+    view = &batchView;
+    for (int tile = 0; tile < NUM_COLUMN_TILES; tile++) {
+        castTile(tile);
+        projectTile(tile);
+    }
+    view = &playerView;
+}
+
+void renderViews(struct CameraState* cameras, int numCameras) {
+    // Returns once every camera's pixels are filled:
+    batchCameras = cameras;
+    runWorkers(renderBatchView, numCameras);
+}
+// =========
@@ -0,0 +1,114 @@
+// Persistent worker pool:
+// =========
+// The workers are started once (one per core, the calling thread being one of them) and park on a barrier
+// between jobs. A job is a function that gets called once per tile index, with tiles handed out through
+// a shared counter, so faster workers simply pick up more of them.
+#include <pthread.h>
+#include <unistd.h>
+
+#define MAX_WORKERS 64
+
+int numWorkers = 0; // 0 for one worker per core
+
+struct Workers {
+    pthread_t threads[MAX_WORKERS];
+    pthread_barrier_t start;
+    pthread_barrier_t finish;
+    pthread_mutex_t launch;
+    void (*job)(int tile);
+    int tileCount;
+    int nextTile;
+    int count;
+    int isRunning;
+} workers;
+
+int countCores() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1)
+        return 1;
+
+    return cores < MAX_WORKERS ? (int)cores : MAX_WORKERS;
+}
+
+void runTiles() {
+    for (int tile = __sync_fetch_and_add(&workers.nextTile, 1);
+         tile < workers.tileCount;
+         tile = __sync_fetch_and_add(&workers.nextTile, 1))
+        workers.job(tile);
+}
+
+void* workerMain(void* arg) {
+    (void)arg;
+    PROFILE_THREAD();
+    // Held by startWorkers until the barriers are sized for the threads that actually started
+    pthread_mutex_lock(&workers.launch);
+    pthread_mutex_unlock(&workers.launch);
+    for (;;) {
+        pthread_barrier_wait(&workers.start);
+        if (!workers.isRunning)
+            break;
+
+        runTiles();
+        pthread_barrier_wait(&workers.finish);
+    }
+    return NULL;
+}
+
+void startWorkers(int count) {
+    workers.count = count < 1 ? 1 : (count > MAX_WORKERS ? MAX_WORKERS : count);
+    workers.isRunning = TRUE;
+    if (workers.count == 1)
+        return;
+
+    pthread_mutex_init(&workers.launch, NULL);
+    pthread_mutex_lock(&workers.launch);
+    for (int i = 1; i < workers.count; i++) {
+        if (pthread_create(&workers.threads[i], NULL, workerMain, NULL) != 0) {
+            fprintf(stderr, "Error creating worker thread, continuing with %d workers\n", i);
+            workers.count = i;
+            break;
+        }
+    }
+
+    if (workers.count == 1) {
+        pthread_mutex_unlock(&workers.launch);
+        pthread_mutex_destroy(&workers.launch);
+        return;
+    }
+
+    pthread_barrier_init(&workers.start, NULL, workers.count);
+    pthread_barrier_init(&workers.finish, NULL, workers.count);
+    pthread_mutex_unlock(&workers.launch);
+}
+
+void runWorkers(void (*job)(int tile), int tileCount) {
+    workers.job = job;
+    workers.tileCount = tileCount;
+    workers.nextTile = 0;
+    if (workers.count == 1) {
+        runTiles();
+        return;
+    }
+
+    pthread_barrier_wait(&workers.start);
+    runTiles();
+    pthread_barrier_wait(&workers.finish);
+}
+
+void stopWorkers() {
+    if (!workers.isRunning)
+        return;
+
+    workers.isRunning = FALSE;
+    if (workers.count == 1)
+        return;
+
+    pthread_barrier_wait(&workers.start);
+    for (int i = 1; i < workers.count; i++)
+        pthread_join(workers.threads[i], NULL);
+
+    pthread_barrier_destroy(&workers.start);
+    pthread_barrier_destroy(&workers.finish);
+    pthread_mutex_destroy(&workers.launch);
+}
+// =========
@@ -0,0 +1,259 @@
+// Stream viewer:
+// =========
+// Connects to a renderer streaming its frames (see src/stream.h), decodes them into a frame of its own, and
+// shows them in a window, or without one when built with HEADLESS (make viewer-headless), e.g. to test a
+// stream end to end on one machine:
+//   ./raycast_headless --stream unix:/tmp/raycast.sock --hash & ./raycast_viewer unix:/tmp/raycast.sock --hash
+// Both print the same frame hash when every frame arrived intact. The viewer counts the bandwidth it received,
+// and the latency from each frame being rendered to it being decoded (which needs both on the same machine).
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#ifndef HEADLESS
+#include <SDL2/SDL.h>
+#endif
+
+#define FALSE 0
+#define TRUE 1
+#define CONNECT_ATTEMPTS 50 // 100ms apart, while the renderer starts
+#define VIEWER_REPORT_LENGTH 1000000000LL
+
+#include "../src/columncodec.h"
+
+struct Viewer {
+    int socket;
+    uint32_t width;
+    uint32_t height;
+    uint32_t* pixels;
+    unsigned char* payload;
+    size_t payloadCapacity;
+    int isHashing;
+    unsigned long long hash;
+
+    // Counters:
+    long long frames;
+    long long bytes;
+    long long totalLatency;
+    long long maxLatency;
+    long long startTime;
+} viewer = {.socket = -1, .hash = 14695981039346656037ULL};
+
+long long monotonicNanoseconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int connectOnce(const char* address) {
+    if (!strncmp(address, "unix:", 5)) {
+        struct sockaddr_un local;
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        strncpy(local.sun_path, address + 5, sizeof(local.sun_path) - 1);
+        const int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connection >= 0 && connect(connection, (struct sockaddr*)&local, sizeof(local)) != 0) {
+            close(connection);
+            return -1;
+        }
+        return connection;
+    }
+
+    // tcp:HOST:PORT
+    char host[256];
+    const char* port = strrchr(address, ':');
+    if (strncmp(address, "tcp:", 4) != 0 || port <= address + 4 || port - (address + 4) >= (long)sizeof(host))
+        return -2;
+    memcpy(host, address + 4, (size_t)(port - (address + 4)));
+    host[port - (address + 4)] = '\0';
+    struct addrinfo hints, *addresses;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port + 1, &hints, &addresses) != 0)
+        return -1;
+    int connection = -1;
+    for (struct addrinfo* a = addresses; a && connection < 0; a = a->ai_next) {
+        connection = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (connection >= 0 && connect(connection, a->ai_addr, a->ai_addrlen) != 0) {
+            close(connection);
+            connection = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return connection;
+}
+
+int connectViewer(const char* address) {
+    for (int attempt = 0; attempt < CONNECT_ATTEMPTS; attempt++) {
+        viewer.socket = connectOnce(address);
+        if (viewer.socket == -2) {
+            fprintf(stderr, "Error: stream addresses are unix:PATH or tcp:HOST:PORT, not %s.\n", address);
+            return FALSE;
+        }
+        if (viewer.socket >= 0)
+            return TRUE;
+        const struct timespec wait = {0, 100000000L};
+        nanosleep(&wait, NULL);
+    }
+    fprintf(stderr, "Error connecting to %s: %s\n", address, strerror(errno));
+    return FALSE;
+}
+
+int receiveAll(void* data, size_t size) {
+    // Returns FALSE once the stream ends:
+    char* bytes = (char*)data;
+    while (size > 0) {
+        const ssize_t received = recv(viewer.socket, bytes, size, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return FALSE;
+        bytes += received;
+        size -= (size_t)received;
+        viewer.bytes += received;
+    }
+    return TRUE;
+}
+
+int startViewer(const char* address) {
+    struct StreamHeader header;
+    if (!connectViewer(address))
+        return FALSE;
+    if (!receiveAll(&header, sizeof(header)) || memcmp(header.magic, STREAM_MAGIC, 4) != 0 ||
+        header.version != STREAM_VERSION || header.width == 0 || header.width > 65536 || header.height == 0 ||
+        header.height > COLUMN_MAX_TOKEN_COUNT) {
+        fprintf(stderr, "Error: %s isn't streaming frames this viewer can decode.\n", address);
+        return FALSE;
+    }
+    viewer.width = header.width;
+    viewer.height = header.height;
+    viewer.pixels = (uint32_t*) calloc((size_t)header.width * header.height, sizeof(uint32_t));
+    viewer.payloadCapacity = header.width * COLUMN_MAX_CODED_SIZE(header.height);
+    viewer.payload = (unsigned char*) malloc(viewer.payloadCapacity);
+    if (!viewer.pixels || !viewer.payload) {
+        fprintf(stderr, "Error allocating frames.\n");
+        return FALSE;
+    }
+    viewer.startTime = monotonicNanoseconds();
+    return TRUE;
+}
+
+int receiveFrame() {
+    // Decodes the next frame over the last one, returning FALSE once the stream ends (or breaks):
+    struct StreamFrameHeader header;
+    if (!receiveAll(&header, sizeof(header)))
+        return FALSE;
+    if (header.payloadSize > viewer.payloadCapacity || header.columns > viewer.width ||
+        !receiveAll(viewer.payload, header.payloadSize) ||
+        decodeColumns(viewer.payload, header.payloadSize, (int)header.columns, viewer.pixels, (int)viewer.width, (int)viewer.height) != header.payloadSize) {
+        fprintf(stderr, "Error: frame %u of the stream is broken.\n", header.frame);
+        return FALSE;
+    }
+
+    const long long latency = monotonicNanoseconds() - (long long)header.renderedAt;
+    viewer.frames++;
+    viewer.totalLatency += latency;
+    viewer.maxLatency = latency > viewer.maxLatency ? latency : viewer.maxLatency;
+    if (viewer.isHashing) {
+        // FNV-1a over every frame's pixels, as the renderer's --hash:
+        const unsigned char* bytes = (const unsigned char*)viewer.pixels;
+        for (size_t i = 0; i < sizeof(uint32_t) * viewer.width * viewer.height; i++) {
+            viewer.hash ^= bytes[i];
+            viewer.hash *= 1099511628211ULL;
+        }
+    }
+    return TRUE;
+}
+
+void printViewerReport() {
+    const double seconds = (monotonicNanoseconds() - viewer.startTime) / 1e9;
+    const long long frames = viewer.frames > 0 ? viewer.frames : 1;
+    printf("viewer: %lld frames, %.1f frames/sec, %.2f MB received, %.2f MB/s\n", viewer.frames,
+        seconds > 0 ? viewer.frames / seconds : 0.0, viewer.bytes / 1e6, seconds > 0 ? viewer.bytes / 1e6 / seconds : 0.0);
+    printf("viewer: latency from rendered to decoded: %.3fms mean, %.3fms max\n",
+        viewer.totalLatency / 1e6 / frames, viewer.maxLatency / 1e6);
+    if (viewer.isHashing)
+        printf("frame hash: %016llx\n", viewer.hash);
+}
+
+int main(int argc, char* argv[]) {
+    const char* address = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--hash"))
+            viewer.isHashing = TRUE;
+        else if (argv[i][0] != '-' && !address)
+            address = argv[i];
+        else {
+            address = NULL;
+            break;
+        }
+    }
+    if (!address) {
+        fprintf(stderr, "Usage: %s unix:PATH|tcp:HOST:PORT [--hash]\n", argv[0]);
+        return 1;
+    }
+    if (!startViewer(address))
+        return 1;
+
+#ifdef HEADLESS
+    while (receiveFrame())
+        ;
+#else
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        fprintf(stderr, "Error initializing SDL.\n");
+        return 1;
+    }
+    SDL_Window* window = SDL_CreateWindow(address, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+        (int)viewer.width, (int)viewer.height, 0);
+    SDL_Renderer* renderer = window ? SDL_CreateRenderer(window, -1, 0) : NULL;
+    SDL_Texture* texture = renderer ? SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+        (int)viewer.width, (int)viewer.height) : NULL;
+    if (!texture) {
+        fprintf(stderr, "Error creating the viewer's window.\n");
+        return 1;
+    }
+
+    // The title shows the counters of the last second:
+    long long reportStart = monotonicNanoseconds(), reportFrames = 0, reportBytes = 0;
+    int isRunning = TRUE;
+    while (isRunning && receiveFrame()) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event))
+            if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE))
+                isRunning = FALSE;
+        SDL_UpdateTexture(texture, NULL, viewer.pixels, (int)(viewer.width * sizeof(uint32_t)));
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+
+        const long long now = monotonicNanoseconds();
+        if (now - reportStart >= VIEWER_REPORT_LENGTH) {
+            char title[128];
+            snprintf(title, sizeof(title), "%s: %.1f frames/sec, %.2f MB/s, %.2fms mean latency", address,
+                (viewer.frames - reportFrames) * 1e9 / (now - reportStart), (viewer.bytes - reportBytes) * 1e3 / (now - reportStart),
+                viewer.totalLatency / 1e6 / viewer.frames);
+            SDL_SetWindowTitle(window, title);
+            reportStart = now;
+            reportFrames = viewer.frames;
+            reportBytes = viewer.bytes;
+        }
+    }
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+#endif
+
+    printViewerReport();
+    close(viewer.socket);
+    free(viewer.pixels);
+    free(viewer.payload);
+    return 0;
+}
+// =========